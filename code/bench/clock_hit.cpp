@@ -0,0 +1,144 @@
+// Compare SharedCache with list-based LRU eviction against CLOCK eviction
+// (EvictMode::CLOCK) on Zipf-distributed keys split among a few tenants: the
+// cost of a lookup, or an insert on a miss, and the hit rate of each.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/hash.h>
+#include <gcache/shared_cache.h>
+
+template <gcache::EvictMode Mode>
+using Cache = gcache::SharedCache<uint32_t, uint32_t, uint64_t, gcache::ghash,
+                                  Mode>;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-n capacity] [-k keys] [-T tenants] [-o ops]"
+              << " [-a alpha,alpha,...]" << std::endl;
+    exit(1);
+}
+
+/// `n` ranks in [0, num_keys) drawn from a Zipf distribution of skew `alpha`
+/// by inverting its CDF, then scattered so hot keys are not adjacent
+std::vector<uint32_t> zipf_keys(uint32_t num_keys, double alpha, size_t n) {
+    std::vector<double> cdf(num_keys);
+    double sum = 0;
+    for (uint32_t i = 0; i < num_keys; ++i) {
+        cdf[i] = sum += 1 / std::pow(i + 1, alpha);
+    }
+    std::vector<uint32_t> scatter(num_keys);
+    for (uint32_t i = 0; i < num_keys; ++i) {
+        scatter[i] = i;
+    }
+    std::mt19937 rng(736);
+    std::shuffle(scatter.begin(), scatter.end(), rng);
+    std::uniform_real_distribution<double> dist(0, sum);
+    std::vector<uint32_t> keys(n);
+    for (auto& k : keys) {
+        auto rank = std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) -
+                    cdf.begin();
+        k = scatter[std::min<size_t>(rank, num_keys - 1)];
+    }
+    return keys;
+}
+
+/// ns per operation and hit rate of one pass over `keys`, starting cold
+template <gcache::EvictMode Mode>
+std::pair<double, double> bench(uint32_t capacity, uint32_t num_tenants,
+                                const std::vector<uint32_t>& keys) {
+    std::vector<std::pair<uint32_t, size_t>> configs;
+    for (uint32_t t = 0; t < num_tenants; ++t) {
+        configs.emplace_back(t, capacity / num_tenants);
+    }
+    Cache<Mode> cache;
+    cache.init(configs);
+    uint64_t hits = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t k : keys) {
+        if (cache.lookup(k)) {
+            ++hits;
+        } else {
+            cache.insert(k % num_tenants, k, false, /*hint_nonexist*/ true);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double, std::nano>(end - begin).count() /
+                keys.size(),
+            static_cast<double>(hits) / keys.size()};
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    uint32_t capacity = 1 << 20;
+    uint32_t num_keys = 1 << 23;
+    uint32_t num_tenants = 4;
+    uint64_t num_ops = 1 << 24;
+    std::vector<double> alphas = {0.8, 0.99, 1.2};
+    int opt;
+    while ((opt = getopt(argc, argv, "n:k:T:o:a:")) != -1) {
+        switch (opt) {
+        case 'n':
+            capacity = std::stoul(optarg);
+            break;
+        case 'k':
+            num_keys = std::stoul(optarg);
+            break;
+        case 'T':
+            num_tenants = std::stoul(optarg);
+            break;
+        case 'o':
+            num_ops = std::stoull(optarg);
+            break;
+        case 'a': {
+            alphas.clear();
+            std::istringstream list(optarg);
+            std::string alpha;
+            while (std::getline(list, alpha, ',')) {
+                alphas.push_back(std::stod(alpha));
+            }
+            break;
+        }
+        default:
+            usage(execname);
+        }
+    }
+    if (optind != argc || num_keys == 0 || num_tenants == 0 ||
+        capacity < num_tenants) {
+        usage(execname);
+    }
+
+    for (double alpha : alphas) {
+        auto keys = zipf_keys(num_keys, alpha, num_ops);
+        // alternate the two over a few rounds and keep the best of each; the
+        // hit rate is the same every round
+        double lru_ns = std::numeric_limits<double>::infinity();
+        double clock_ns = std::numeric_limits<double>::infinity();
+        double lru_hit = 0;
+        double clock_hit = 0;
+        for (int round = 0; round < 3; ++round) {
+            auto [l, lh] =
+                bench<gcache::EvictMode::LRU>(capacity, num_tenants, keys);
+            auto [c, ch] =
+                bench<gcache::EvictMode::CLOCK>(capacity, num_tenants, keys);
+            lru_ns = std::min(lru_ns, l);
+            clock_ns = std::min(clock_ns, c);
+            lru_hit = lh;
+            clock_hit = ch;
+        }
+        std::cout << "alpha " << alpha << ": LRU " << lru_ns << " ns/op ("
+                  << lru_hit * 100 << "% hits), CLOCK " << clock_ns
+                  << " ns/op (" << clock_hit * 100 << "% hits)" << std::endl;
+    }
+    return 0;
+}
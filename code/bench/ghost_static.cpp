@@ -0,0 +1,101 @@
+// Compare the access cost of GhostCache, which takes tick/min/max at run
+// time, with StaticGhostCache, which fixes them at compile time, on the same
+// skewed block stream; both must end up with the same stats.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/ghost_cache.h>
+#include <gcache/static_ghost_cache.h>
+
+constexpr uint32_t kTick = 64;
+constexpr uint32_t kMin = 64;
+constexpr uint32_t kMax = 1024;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname << " [-n accesses] [-k blocks]"
+              << std::endl;
+    exit(1);
+}
+
+template <class Cache>
+double bench(Cache& cache, const std::vector<uint32_t>& blocks) {
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t b : blocks) {
+        cache.access(b);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() /
+           blocks.size();
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    uint64_t num_accesses = 1 << 24;
+    uint32_t num_blocks = 4096;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:k:")) != -1) {
+        switch (opt) {
+        case 'n':
+            num_accesses = std::stoull(optarg);
+            break;
+        case 'k':
+            num_blocks = std::stoul(optarg);
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (optind != argc || num_blocks == 0) {
+        usage(execname);
+    }
+
+    // generate blocks up front so the RNG is not in the timed loop; a
+    // geometric distribution gives reuse at every distance up to kMax
+    std::mt19937 rng(736);
+    std::geometric_distribution<uint32_t> dist(2.0 / num_blocks);
+    std::vector<uint32_t> blocks(num_accesses);
+    for (auto& b : blocks) {
+        b = dist(rng) % num_blocks;
+    }
+
+    gcache::GhostCache<> dynamic_cache(kTick, kMin, kMax);
+    gcache::StaticGhostCache<kTick, kMin, kMax> static_cache;
+    // alternate the two over a few rounds and keep the best of each, so
+    // neither is favored by running first or by a noisy round; the first
+    // round only warms up both caches
+    double dynamic_ns = std::numeric_limits<double>::infinity();
+    double static_ns = std::numeric_limits<double>::infinity();
+    for (int round = 0; round < 5; ++round) {
+        dynamic_cache.reset_stat();
+        static_cache.reset_stat();
+        double d = bench(dynamic_cache, blocks);
+        double s = bench(static_cache, blocks);
+        if (round > 0) {
+            dynamic_ns = std::min(dynamic_ns, d);
+            static_ns = std::min(static_ns, s);
+        }
+    }
+    std::cout << "GhostCache:       " << dynamic_ns << " ns/access"
+              << std::endl;
+    std::cout << "StaticGhostCache: " << static_ns << " ns/access"
+              << std::endl;
+
+    for (uint32_t size = kMin; size <= kMax; size += kTick) {
+        auto& d = dynamic_cache.get_stat(size);
+        auto& s = static_cache.get_stat(size);
+        if (d.hit_cnt != s.hit_cnt || d.miss_cnt != s.miss_cnt) {
+            std::cerr << "stats differ at size " << size << ": " << d
+                      << " vs " << s << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Measure LRUCache lookup latency with the handle pool and table placed by a
+// PageResource: regular pages, transparent huge pages or hugetlbfs pages,
+// optionally bound to a NUMA node. Run it pinned to one node (e.g. with
+// `numactl -N 0`) and bind the pool to the same or the other node to see the
+// remote-access penalty on a multi-socket machine.
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/hash.h>
+#include <gcache/lru_cache.h>
+#include <gcache/page_resource.h>
+
+using gcache::PageMode, gcache::PageResource;
+using Cache = gcache::LRUCache<uint32_t, uint64_t, gcache::ghash>;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-n capacity] [-l lookups] [-m normal|thp|hugetlb|all]"
+              << " [-N numa_node]" << std::endl;
+    exit(1);
+}
+
+double bench(PageMode mode, int numa_node, uint32_t capacity,
+             uint64_t num_lookups) {
+    PageResource resource(mode, numa_node);
+    Cache cache(&resource);
+    cache.init(capacity);
+    for (uint32_t i = 0; i < capacity; ++i) {
+        cache.insert(i);
+    }
+    if (mode == PageMode::HUGETLB && resource.num_fallbacks()) {
+        std::cout << "(no hugetlbfs pages reserved; fell back to THP) ";
+    }
+
+    // generate keys up front so the RNG is not in the timed loop
+    std::mt19937 rng(736);
+    std::uniform_int_distribution<uint32_t> dist(0, capacity - 1);
+    std::vector<uint32_t> keys(1 << 20);
+    for (auto& k : keys) {
+        k = dist(rng);
+    }
+
+    uint64_t found = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < num_lookups; ++i) {
+        found += cache.lookup(keys[i & (keys.size() - 1)]) != nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (found != num_lookups) {
+        std::cerr << "unexpected misses: " << num_lookups - found << std::endl;
+    }
+    return std::chrono::duration<double, std::nano>(end - begin).count() /
+           num_lookups;
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    uint32_t capacity = 1 << 24;
+    uint64_t num_lookups = 1 << 24;
+    std::string mode("all");
+    int numa_node = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:m:N:")) != -1) {
+        switch (opt) {
+        case 'n':
+            capacity = std::stoul(optarg);
+            break;
+        case 'l':
+            num_lookups = std::stoull(optarg);
+            break;
+        case 'm':
+            mode = optarg;
+            break;
+        case 'N':
+            numa_node = std::stoi(optarg);
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (optind != argc || capacity == 0) {
+        usage(execname);
+    }
+
+    std::vector<std::pair<std::string, PageMode>> modes = {
+        {"normal", PageMode::NORMAL},
+        {"thp", PageMode::TRANSPARENT},
+        {"hugetlb", PageMode::HUGETLB}};
+    bool ran = false;
+    for (auto& [name, m] : modes) {
+        if (mode != "all" && mode != name) {
+            continue;
+        }
+        std::cout << name << ": ";
+        try {
+            std::cout << bench(m, numa_node, capacity, num_lookups)
+                      << " ns/lookup" << std::endl;
+        } catch (const std::bad_alloc& e) {
+            std::cout << "allocation failed (is NUMA node " << numa_node
+                      << " online?)" << std::endl;
+            return 1;
+        }
+        ran = true;
+    }
+    if (!ran) {
+        usage(execname);
+    }
+    return 0;
+}
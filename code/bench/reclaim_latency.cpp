@@ -0,0 +1,139 @@
+// Measure insert latency in SharedCache under a mixed read/insert load with
+// and without a background Reclaimer: without it, a miss evicts on the spot
+// when the tenant's free list is empty; with it, objects are evicted ahead of
+// time in batches on another thread and most inserts pop a free handle. Every
+// op holds the cache's mutex, as the reclaimer requires.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/hash.h>
+#include <gcache/reclaimer.h>
+#include <gcache/shared_cache.h>
+
+using Cache = gcache::SharedCache<uint32_t, uint32_t, uint64_t, gcache::ghash,
+                                  gcache::EvictMode::LRU>;
+using Clock = std::chrono::steady_clock;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-n capacity] [-k keys] [-T tenants] [-o ops]" << std::endl;
+    exit(1);
+}
+
+/// Latency percentiles of the inserts in a pass over `keys`, starting warm
+void bench(uint32_t capacity, uint32_t num_tenants,
+           const std::vector<uint32_t>& keys, bool reclaim) {
+    std::vector<std::pair<uint32_t, size_t>> configs;
+    std::vector<uint32_t> tags;
+    for (uint32_t t = 0; t < num_tenants; ++t) {
+        configs.emplace_back(t, capacity / num_tenants);
+        tags.push_back(t);
+    }
+    Cache cache;
+    cache.init(configs);
+    std::mutex mtx;
+    // warm up so every tenant's cache is full
+    for (uint32_t k : keys) {
+        if (!cache.lookup(k)) {
+            cache.insert(k % num_tenants, k, false, /*hint_nonexist*/ true);
+        }
+    }
+    std::unique_ptr<gcache::Reclaimer<Cache, uint32_t>> reclaimer;
+    if (reclaim) {
+        reclaimer =
+            std::make_unique<gcache::Reclaimer<Cache, uint32_t>>(cache, mtx,
+                                                                 tags);
+    }
+
+    std::vector<float> latencies;
+    latencies.reserve(keys.size());
+    uint64_t num_evicting = 0;
+    auto begin = Clock::now();
+    for (uint32_t k : keys) {
+        auto op_begin = Clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (cache.lookup(k)) {
+            continue;
+        }
+        uint32_t tag = k % num_tenants;
+        if (!cache.num_free_of(tag)) {
+            ++num_evicting;
+        }
+        cache.insert(tag, k, false, /*hint_nonexist*/ true);
+        latencies.push_back(std::chrono::duration<float, std::nano>(
+                                Clock::now() - op_begin)
+                                .count());
+    }
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    if (reclaimer) {
+        reclaimer->stop();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+        return latencies[std::min<size_t>(latencies.size() * p,
+                                          latencies.size() - 1)];
+    };
+    std::cout << (reclaim ? "reclaimer" : "inline eviction") << ": "
+              << latencies.size() << " inserts (" << num_evicting
+              << " evicting inline), insert latency p50 " << pct(0.5)
+              << " ns, p99 " << pct(0.99) << " ns, p99.9 " << pct(0.999)
+              << " ns; " << keys.size() / elapsed / 1e6 << " Mops/s"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    uint32_t capacity = 1 << 20;
+    uint32_t num_keys = 1 << 22;
+    uint32_t num_tenants = 4;
+    uint64_t num_ops = 1 << 23;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:k:T:o:")) != -1) {
+        switch (opt) {
+        case 'n':
+            capacity = std::stoul(optarg);
+            break;
+        case 'k':
+            num_keys = std::stoul(optarg);
+            break;
+        case 'T':
+            num_tenants = std::stoul(optarg);
+            break;
+        case 'o':
+            num_ops = std::stoull(optarg);
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (optind != argc || num_keys == 0 || num_tenants == 0 ||
+        capacity < num_tenants) {
+        usage(execname);
+    }
+
+    // a skewed mix: a hot quarter of the keys takes most reads, the rest
+    // mostly miss and insert
+    std::mt19937 rng(736);
+    std::uniform_int_distribution<uint32_t> hot(0, num_keys / 4);
+    std::uniform_int_distribution<uint32_t> any(0, num_keys - 1);
+    std::bernoulli_distribution is_hot(0.7);
+    std::vector<uint32_t> keys(num_ops);
+    for (auto& k : keys) {
+        k = is_hot(rng) ? hot(rng) : any(rng);
+    }
+    for (bool reclaim : {false, true}) {
+        bench(capacity, num_tenants, keys, reclaim);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Measure SharedCache::relocate, which moves handles in bulk, against the same
+// relocation done a handle at a time (relocate of 1, repeated): the time to
+// move handles out of a tenant's free list and out of its full LRU list, and
+// the latency of lookups interleaved with periodic relocations between two
+// busy tenants.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/hash.h>
+#include <gcache/shared_cache.h>
+
+using Cache = gcache::SharedCache<uint32_t, uint32_t, uint64_t, gcache::ghash,
+                                  gcache::EvictMode::LRU>;
+using Clock = std::chrono::steady_clock;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-n capacity] [-m handles moved] [-o ops]"
+              << " [-r ops between relocations]" << std::endl;
+    exit(1);
+}
+
+double ms_since(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin)
+        .count();
+}
+
+size_t relocate(Cache& cache, uint32_t src, uint32_t dst, size_t n,
+                bool bulk) {
+    if (bulk) {
+        return cache.relocate(src, dst, n);
+    }
+    size_t moved = 0;
+    while (moved < n && cache.relocate(src, dst, 1)) {
+        ++moved;
+    }
+    return moved;
+}
+
+/// Time to relocate `moved` handles from a tenant, first free, then full
+void bench_move(uint32_t capacity, uint32_t moved, bool bulk) {
+    Cache cache;
+    cache.init({{0, capacity}, {1, capacity}});
+    auto begin = Clock::now();
+    relocate(cache, 0, 1, moved, bulk);
+    double free_ms = ms_since(begin);
+    // fill both tenants, with more keys than either holds
+    for (uint32_t k = 0; k < capacity * 4; ++k) {
+        if (!cache.lookup(k)) {
+            cache.insert(k % 2, k, false, /*hint_nonexist*/ true);
+        }
+    }
+    begin = Clock::now();
+    relocate(cache, 1, 0, moved, bulk);
+    double evict_ms = ms_since(begin);
+    std::cout << (bulk ? "bulk" : "one at a time") << ": moved " << moved
+              << " free handles in " << free_ms << " ms, evicted and moved "
+              << moved << " in " << evict_ms << " ms" << std::endl;
+}
+
+/// Latency percentiles of lookups (inserts on misses) while `moved` handles
+/// go back and forth between the two tenants every `interval` ops; a
+/// relocation is charged to the op that triggers it
+void bench_tail(uint32_t capacity, uint32_t moved, uint64_t num_ops,
+                uint64_t interval, bool bulk) {
+    Cache cache;
+    cache.init({{0, capacity}, {1, capacity}});
+    std::mt19937 rng(736);
+    std::uniform_int_distribution<uint32_t> dist(0, capacity * 4 - 1);
+    std::vector<uint32_t> keys(num_ops);
+    for (auto& k : keys) {
+        k = dist(rng);
+    }
+    std::vector<float> latencies(num_ops);
+    uint32_t src = 0;
+    for (uint64_t i = 0; i < num_ops; ++i) {
+        uint32_t k = keys[i];
+        auto begin = Clock::now();
+        if (!cache.lookup(k) && cache.capacity_of(k % 2)) {
+            cache.insert(k % 2, k, false, /*hint_nonexist*/ true);
+        }
+        if (i % interval == interval - 1) {
+            relocate(cache, src, 1 - src, moved, bulk);
+            src = 1 - src;
+        }
+        latencies[i] = std::chrono::duration<float, std::micro>(Clock::now() -
+                                                                begin)
+                           .count();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+        return latencies[std::min<size_t>(num_ops * p, num_ops - 1)];
+    };
+    std::cout << (bulk ? "bulk" : "one at a time") << ": op latency p50 "
+              << pct(0.5) << " us, p99.99 " << pct(0.9999) << " us, max "
+              << latencies.back() << " us" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    uint32_t capacity = 1 << 22;
+    uint32_t moved = 1 << 20;
+    uint64_t num_ops = 1 << 24;
+    uint64_t interval = 1 << 21;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:o:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            capacity = std::stoul(optarg);
+            break;
+        case 'm':
+            moved = std::stoul(optarg);
+            break;
+        case 'o':
+            num_ops = std::stoull(optarg);
+            break;
+        case 'r':
+            interval = std::stoull(optarg);
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (optind != argc || capacity == 0 || moved > capacity || num_ops == 0 ||
+        interval == 0) {
+        usage(execname);
+    }
+
+    for (bool bulk : {false, true}) {
+        bench_move(capacity, moved, bulk);
+    }
+    for (bool bulk : {false, true}) {
+        bench_tail(capacity, moved, num_ops, interval, bulk);
+    }
+    return 0;
+}
@@ -1,52 +1,240 @@
 #pragma once
 
 #include <algorithm>
+#include <concepts>
 #include <cstdint>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
+#include <gcache/ghost_cache.h>
 #include <gcache/ghost_kv_cache.h>
 #include <gcache/stat.h>
 #include <nlohmann/json.hpp>
 
+#include "histogram.hpp"
+#include "snapshot.hpp"
+#include "timeseries.hpp"
 #include "trace.hpp"
 
 namespace mtcache {
 
 using MissRateCurve = std::vector<std::tuple<
-    /*count*/ uint32_t, /*size*/ uint32_t, /*miss_rate*/ gcache::CacheStat>>;
+    /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ gcache::CacheStat>>;
+
+/// Format each point of a curve as in the dumped stats: "count size stat"
+inline std::vector<std::string>
+miss_rate_curve_as_strings(const MissRateCurve& curve) {
+    std::vector<std::string> curve_strs;
+    for (auto& point : curve) {
+        std::ostringstream oss;
+        oss << std::get<0>(point) << " " << std::get<1>(point)
+            << std::get<2>(point);
+        curve_strs.emplace_back(oss.view());
+    }
+    return curve_strs;
+}
+
+/// Whether the engine keeps windowed stats besides the cumulative ones
+template <class Cache>
+concept WindowedCache = requires(Cache& c, double decay) {
+    c.roll_window(decay);
+    c.get_cache_stat_curve(gcache::StatWindow::WINDOW);
+};
+
+/// Whether the engine can replay an access without counting it in its stats,
+/// i.e., only to warm up its state
+template <class Cache>
+concept WarmableCache = requires(Cache& c, const std::string& key,
+                                 uint32_t size) {
+    c.access(key, size, gcache::AccessMode::NOOP);
+};
+
+/// Whether the engine can export its reuse distance histogram
+template <class Cache>
+concept HistogramCache = requires(const Cache& c) {
+    { c.get_reuse_histogram() } -> std::same_as<gcache::ReuseHistogram>;
+};
+
+/// Whether the engine's state can be saved into and restored from a snapshot
+template <class Cache>
+concept SnapshotCache = requires(Cache& c, const Cache& cc, char* out,
+                                 const char* in, size_t len) {
+    { cc.snapshot_size() } -> std::convertible_to<size_t>;
+    cc.save(out);
+    { c.load(in, len) } -> std::same_as<bool>;
+};
+
 template <class Cache> class TenantCache {
   private:
-    std::unique_ptr<Cache> cache;
-    uint32_t reqs_processed;
+    // Destroy the engine and return its memory to where it came from
+    struct CacheDeleter {
+        std::pmr::memory_resource* mr;
+        void operator()(Cache* c) const {
+            std::pmr::polymorphic_allocator<Cache>(mr).delete_object(c);
+        }
+    };
+
+    std::unique_ptr<Cache, CacheDeleter> cache;
+    uint64_t reqs_processed;
     std::optional<uint64_t> first_ts;
     std::optional<uint64_t> last_ts;
     std::map<uint64_t, MissRateCurve> timed_miss_rate_curves;
+    // only populated if the engine is a WindowedCache: curves of accesses
+    // since the previous checkpoint, and exponentially decayed over them
+    std::map<uint64_t, MissRateCurve> timed_window_curves;
+    std::map<uint64_t, MissRateCurve> timed_decayed_curves;
     bool is_finalized;
+    // whether the engine has seen an access since the last checkpoint; if
+    // not, its cumulative curve is unchanged and is not assembled again
+    bool curve_stale = true;
+    // optional sub-checkpoint time series at a fixed reference size
+    TimeSeriesRecorder* recorder = nullptr;
+    uint32_t ref_count = 0;
+    // optional export of the reuse distance histogram at each checkpoint
+    HistogramWriter* histogram_writer = nullptr;
+    uint64_t client = 0;
+    uint64_t histogram_reqs = 0; // reqs_processed at the last export
+
+    /// Everything but the engine; every field is a multiple of 8 bytes so
+    /// the engine's state that follows stays 8-byte aligned
+    void save_state(SnapshotWriter& w) const {
+        w.put<uint64_t>(first_ts.value_or(0));
+        w.put<uint64_t>(last_ts.value_or(0));
+        w.put<uint64_t>(first_ts.has_value());
+        w.put<uint64_t>(reqs_processed);
+        for (auto* curves : {&timed_miss_rate_curves, &timed_window_curves,
+                             &timed_decayed_curves}) {
+            w.put<uint64_t>(curves->size());
+            for (auto& [ts, curve] : *curves) {
+                w.put<uint64_t>(ts);
+                w.put<uint64_t>(curve.size());
+                for (auto& [count, size, stat] : curve) {
+                    w.put<uint64_t>(count);
+                    w.put<uint64_t>(size);
+                    w.put<uint64_t>(stat.hit_cnt);
+                    w.put<uint64_t>(stat.miss_cnt);
+                }
+            }
+        }
+    }
 
-    std::vector<std::string>
-    miss_rate_curve_as_strings(const MissRateCurve& curve) const {
-        std::vector<std::string> curve_strs;
-        for (auto& point : curve) {
-            std::ostringstream oss;
-            oss << std::get<0>(point) << " " << std::get<1>(point)
-                << std::get<2>(point);
-            curve_strs.emplace_back(oss.view());
+    /// Return false if the state runs past the end of `r`
+    bool load_state(SnapshotReader& r) {
+        auto first = r.get<uint64_t>();
+        auto last = r.get<uint64_t>();
+        if (r.get<uint64_t>()) {
+            first_ts = first;
+            last_ts = last;
+        }
+        reqs_processed = r.get<uint64_t>();
+        for (auto* curves : {&timed_miss_rate_curves, &timed_window_curves,
+                             &timed_decayed_curves}) {
+            auto num_curves = r.get<uint64_t>();
+            for (uint64_t i = 0; i < num_curves && r.ok(); ++i) {
+                auto ts = r.get<uint64_t>();
+                auto num_points = r.get<uint64_t>();
+                // check before allocating for a count read from the file
+                if (num_points > r.remaining() / (4 * sizeof(uint64_t))) {
+                    return false;
+                }
+                MissRateCurve curve(num_points);
+                for (auto& [count, size, stat] : curve) {
+                    count = r.get<uint64_t>();
+                    size = r.get<uint64_t>();
+                    stat.hit_cnt = r.get<uint64_t>();
+                    stat.miss_cnt = r.get<uint64_t>();
+                }
+                curves->emplace(ts, std::move(curve));
+            }
+        }
+        return r.ok();
+    }
+
+    static Cache* make_cache(uint32_t tick, uint32_t min_count,
+                             uint32_t max_count,
+                             std::pmr::memory_resource* mr) {
+        std::pmr::polymorphic_allocator<Cache> alloc(mr);
+        // engines that take a memory resource put all their state there
+        if constexpr (std::is_constructible_v<Cache, uint32_t, uint32_t,
+                                              uint32_t,
+                                              std::pmr::memory_resource*>) {
+            return alloc.template new_object<Cache>(tick, min_count, max_count,
+                                                    mr);
+        } else {
+            return alloc.template new_object<Cache>(tick, min_count,
+                                                    max_count);
         }
-        return curve_strs;
     }
 
   public:
-    TenantCache<Cache>(uint32_t tick, uint32_t min_count, uint32_t max_count)
-        : cache(std::make_unique<Cache>(tick, min_count, max_count)),
-          is_finalized(false) {}
+    /// The engine is allocated from `mr`, which must outlive this object
+    TenantCache(
+        uint32_t tick, uint32_t min_count, uint32_t max_count,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : cache(make_cache(tick, min_count, max_count, mr), CacheDeleter{mr}),
+          reqs_processed(0), is_finalized(false) {}
+
+    /// Size in bytes of the snapshot written by `save`
+    size_t snapshot_size() const
+        requires SnapshotCache<Cache>
+    {
+        SnapshotWriter w;
+        save_state(w);
+        return w.size() + cache->snapshot_size();
+    }
+
+    /// Save the timestamps, checkpointed curves and engine state into `buf`
+    /// of `snapshot_size()` bytes; the time series recorder is not saved
+    void save(char* buf) const
+        requires SnapshotCache<Cache>
+    {
+        SnapshotWriter w(buf);
+        save_state(w);
+        cache->save(w.cur());
+    }
+
+    /// Restore what `save` wrote (`len` bytes) into a tenant that has not
+    /// seen any access; return false if the engine was configured differently
+    /// or the snapshot is cut short
+    bool load(const char* buf, size_t len)
+        requires SnapshotCache<Cache>
+    {
+        assert(!first_ts);
+        SnapshotReader r(buf, len);
+        if (!load_state(r)) {
+            return false;
+        }
+        return cache->load(r.cur(), r.remaining());
+    }
+
+    /// Record hits/misses at cache size `ref_count` per epoch into `r`
+    void attach_time_series(TimeSeriesRecorder* r, uint32_t count) {
+        recorder = r;
+        ref_count = count;
+    }
+
+    /// Write the engine's reuse distance histogram into `w` at each
+    /// checkpoint, as the histogram of `client`
+    void attach_histogram_writer(HistogramWriter* w, uint64_t client)
+        requires HistogramCache<Cache>
+    {
+        histogram_writer = w;
+        this->client = client;
+    }
 
     void access(const TraceReq& req) {
+        if (recorder) {
+            recorder->record(req.timeStamp, req.keySize + req.valSize,
+                             [this] { return cache->get_stat(ref_count); });
+        }
         cache->access(req.key, req.keySize + req.valSize);
+        curve_stale = true;
         if (last_ts) {
             last_ts = std::max(req.timeStamp, *last_ts);
         } else {
@@ -56,13 +244,54 @@ template <class Cache> class TenantCache {
         reqs_processed++;
     }
 
-    void checkpoint_stats(uint64_t timestamp) {
-        timed_miss_rate_curves.insert({timestamp, get_cache_stat_curve()});
+    /// Replay an access only to warm up the engine; it is not counted in any
+    /// stat nor timestamp
+    void warm(const TraceReq& req)
+        requires WarmableCache<Cache>
+    {
+        cache->access(req.key, req.keySize + req.valSize,
+                      gcache::AccessMode::NOOP);
+        curve_stale = true;
+    }
+
+    /// Snapshot the curves; `decay` is the weight of the history before this
+    /// checkpoint in the decayed curve
+    void checkpoint_stats(uint64_t timestamp, double decay = 0.5) {
+        // most tenants are idle between checkpoints; checkpoints come in
+        // time order, so the last curve is the most recent one
+        if (!curve_stale && !timed_miss_rate_curves.empty()) {
+            timed_miss_rate_curves.emplace_hint(
+                timed_miss_rate_curves.end(), timestamp,
+                timed_miss_rate_curves.rbegin()->second);
+        } else {
+            timed_miss_rate_curves.insert({timestamp, get_cache_stat_curve()});
+        }
+        curve_stale = false;
+        if constexpr (HistogramCache<Cache>) {
+            // the histogram is unchanged if there was no access since
+            if (histogram_writer && histogram_reqs != reqs_processed) {
+                histogram_writer->write(client, timestamp,
+                                        cache->get_reuse_histogram());
+                histogram_reqs = reqs_processed;
+            }
+        }
+        if constexpr (WindowedCache<Cache>) {
+            cache->roll_window(decay);
+            timed_window_curves.insert(
+                {timestamp,
+                 cache->get_cache_stat_curve(gcache::StatWindow::WINDOW)});
+            timed_decayed_curves.insert(
+                {timestamp,
+                 cache->get_cache_stat_curve(gcache::StatWindow::DECAYED)});
+        }
     }
 
     void finalize() {
         assert(first_ts);
         assert(last_ts);
+        if (recorder) {
+            recorder->close_epoch(cache->get_stat(ref_count));
+        }
         is_finalized = true;
     }
 
@@ -78,12 +307,32 @@ template <class Cache> class TenantCache {
             out_obj["mrcs"][std::to_string(kv.first)] =
                 miss_rate_curve_as_strings(kv.second);
         }
+        if constexpr (WindowedCache<Cache>) {
+            out_obj["window_mrcs"] = json::object();
+            for (auto& kv : timed_window_curves) {
+                out_obj["window_mrcs"][std::to_string(kv.first)] =
+                    miss_rate_curve_as_strings(kv.second);
+            }
+            out_obj["decayed_mrcs"] = json::object();
+            for (auto& kv : timed_decayed_curves) {
+                out_obj["decayed_mrcs"][std::to_string(kv.first)] =
+                    miss_rate_curve_as_strings(kv.second);
+            }
+        }
         outfile << out_obj.dump() << std::endl;
     }
 
     MissRateCurve get_cache_stat_curve() const {
         return cache->get_cache_stat_curve();
     }
+
+    const std::optional<uint64_t>& get_first_ts() const { return first_ts; }
+    const std::optional<uint64_t>& get_last_ts() const { return last_ts; }
+    uint64_t get_reqs_processed() const { return reqs_processed; }
+    /// Cumulative curves at each checkpoint
+    const std::map<uint64_t, MissRateCurve>& get_checkpoint_curves() const {
+        return timed_miss_rate_curves;
+    }
 };
 
 } // namespace mtcache
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "histogram.hpp"
+
+namespace mtcache {
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'T', 'C', 'H', 'I', 'S', 'T', '1'};
+
+} // namespace
+
+HistogramWriter::HistogramWriter(const std::string& path,
+                                 std::optional<uint32_t> log_bits)
+    : out(path, std::ios::binary | std::ios::trunc), path(path),
+      log_bits(log_bits) {
+    if (!out.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    out.write(kMagic, sizeof(kMagic));
+}
+
+void HistogramWriter::put(uint64_t v) {
+    char buf[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    out.write(buf, n);
+}
+
+void HistogramWriter::write(uint64_t client, uint64_t timestamp,
+                            const gcache::ReuseHistogram& hist) {
+    gcache::ReuseHistogram bucketed;
+    if (log_bits) {
+        bucketed = hist.log_bucketed(*log_bits);
+    }
+    const auto& h = log_bits ? bucketed : hist;
+
+    // an empty bucket only matters as the lower bound of the next one
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < h.bounds.size(); ++i) {
+        bool last = i + 1 == h.bounds.size();
+        if (h.counts[i] || (!last && h.counts[i + 1])) {
+            kept.push_back(i);
+        }
+    }
+    put(client);
+    put(timestamp);
+    put(h.total);
+    put(kept.size());
+    uint32_t prev = 0;
+    for (size_t i : kept) {
+        put(h.bounds[i] - prev);
+        put(h.counts[i]);
+        prev = h.bounds[i];
+    }
+    if (!out) {
+        throw std::runtime_error(path + ": could not write histogram");
+    }
+}
+
+HistogramReader::HistogramReader(const std::string& path)
+    : in(path, std::ios::binary), path(path) {
+    if (!in.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    char magic[sizeof(kMagic)];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kMagic, sizeof(magic))) {
+        throw std::runtime_error(path + ": not a histogram file");
+    }
+}
+
+bool HistogramReader::get(uint64_t& v) {
+    v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == std::ifstream::traits_type::eof()) {
+            return false;
+        }
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    throw std::runtime_error(path + ": malformed varint");
+}
+
+bool HistogramReader::next(HistogramRecord& rec) {
+    if (!get(rec.client)) {
+        return false;
+    }
+    uint64_t num_buckets;
+    if (!get(rec.timestamp) || !get(rec.hist.total) || !get(num_buckets)) {
+        throw std::runtime_error(path + ": truncated histogram");
+    }
+    rec.hist.bounds.clear();
+    rec.hist.counts.clear();
+    uint64_t bound = 0;
+    for (uint64_t i = 0; i < num_buckets; ++i) {
+        uint64_t delta, count;
+        if (!get(delta) || !get(count)) {
+            throw std::runtime_error(path + ": truncated histogram");
+        }
+        bound += delta;
+        if (delta == 0 || bound > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error(path + ": malformed histogram");
+        }
+        rec.hist.bounds.push_back(bound);
+        rec.hist.counts.push_back(count);
+    }
+    return true;
+}
+
+} // namespace mtcache
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <gcache/reuse_histogram.h>
+
+namespace mtcache {
+
+/// One tenant's cumulative reuse distance histogram at one checkpoint
+struct HistogramRecord {
+    uint64_t client;
+    uint64_t timestamp;
+    gcache::ReuseHistogram hist;
+};
+
+/// Writes reuse distance histograms into a compact binary file: the magic
+/// "MTCHIST1", then one record per tenant per checkpoint, all in LEB128
+/// varints: client, timestamp, total, number of buckets, then each bucket's
+/// bound as a delta from the previous one and its count. Records of one
+/// checkpoint are contiguous.
+///
+/// Histograms are cumulative and most tenants are idle between checkpoints,
+/// so TenantCache skips a tenant's record if it has had no access since its
+/// previous one. Runs of empty buckets are merged into one and trailing ones
+/// dropped, which leaves the interpolated stats unchanged.
+class HistogramWriter {
+  private:
+    std::ofstream out;
+    std::string path;
+    std::optional<uint32_t> log_bits;
+
+    void put(uint64_t v);
+
+  public:
+    /// Histograms are written at full resolution unless `log_bits` is set;
+    /// see gcache::ReuseHistogram::log_bucketed
+    explicit HistogramWriter(const std::string& path,
+                             std::optional<uint32_t> log_bits = std::nullopt);
+
+    void write(uint64_t client, uint64_t timestamp,
+               const gcache::ReuseHistogram& hist);
+};
+
+/// Reads back the records of a HistogramWriter in order
+class HistogramReader {
+  private:
+    std::ifstream in;
+    std::string path;
+
+    bool get(uint64_t& v);
+
+  public:
+    explicit HistogramReader(const std::string& path);
+
+    /// Read the next record into `rec`; return false at the end of the file
+    bool next(HistogramRecord& rec);
+};
+
+} // namespace mtcache
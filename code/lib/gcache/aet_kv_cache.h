@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * Approximate the miss ratio curve of a key-value cache with the AET (Average
+ * Eviction Time) model (Hu et al., ATC'16). Each access only costs a hash
+ * lookup to find the key's last access time and an increment on the reuse time
+ * histogram; the whole curve is derived from the histogram when queried:
+ * with P(t) the probability that a reuse time is larger than t, a cache of c
+ * keys evicts a key after AET(c) = T where sum_{t<T} P(t) = c, so its miss
+ * ratio is P(AET(c)).
+ *
+ * Reuse times are kept in a log-linear histogram: exact below 2 * sub_buckets,
+ * and each power of two beyond is split into sub_buckets buckets.
+ *
+ * By default support no sampling; similar to SampledGhostKvCache, setting
+ * SampleShift only tracks keys whose hash has that many leading zeros.
+ */
+template <uint32_t SampleShift = 0,
+          typename Hash = std::hash<std::string_view>>
+class AetKvCache {
+  static constexpr uint32_t sub_shift = 4;
+  static constexpr uint64_t sub_buckets = 1 << sub_shift;
+  static constexpr uint32_t num_buckets = 2 * sub_buckets + 64 * sub_buckets;
+
+  const uint32_t tick;
+  const uint32_t min_count;
+  const uint32_t max_count;
+  const uint32_t num_ticks;
+
+  // key hash -> logical time of the last access
+  std::unordered_map<uint64_t, uint64_t> last_access;
+  uint64_t now;
+
+  std::vector<uint64_t> reuse_times;  // histogram of reuse times
+  uint64_t cold_count;                // accesses without reuse
+  uint64_t reuse_count;               // count all accesses
+  uint64_t kv_size_sum;               // used to convert count into size
+
+  std::vector<CacheStat> caches_stat;
+  uint64_t caches_stat_count;  // reuse_count when caches_stat was built
+
+  static uint32_t bucket_of(uint64_t rt) {
+    if (rt < 2 * sub_buckets) return rt;
+    uint32_t e = std::bit_width(rt) - 1;  // rt in [2^e, 2^(e+1))
+    uint32_t sub = (rt >> (e - sub_shift)) & (sub_buckets - 1);
+    return 2 * sub_buckets + (e - sub_shift - 1) * sub_buckets + sub;
+  }
+
+  // Lower bound of reuse times falling into the bucket
+  static double bucket_lo(uint32_t b) {
+    if (b < 2 * sub_buckets) return b;
+    uint32_t e = (b - 2 * sub_buckets) / sub_buckets + sub_shift + 1;
+    uint32_t sub = (b - 2 * sub_buckets) % sub_buckets;
+    return std::ldexp(1.0 * (sub_buckets + sub), e - sub_shift);
+  }
+
+  // Walk the histogram to solve AET(c) for each curve point; P(t) is
+  // interpolated linearly within a bucket.
+  void build_caches_stat() {
+    if (caches_stat_count == reuse_count) return;
+    caches_stat_count = reuse_count;
+    uint64_t tail = reuse_count;  // number of reuse times >= current bucket
+    double area = 0;              // sum_{t < current bucket} P(t)
+    uint32_t b = 0;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      double c = static_cast<double>(min_count + idx * tick) /
+                 (uint64_t{1} << SampleShift);
+      double miss_rate = 1;
+      for (;;) {
+        double p_lo = reuse_count ? static_cast<double>(tail) / reuse_count : 0;
+        if (b == num_buckets) {
+          // beyond the last bucket, only cold misses remain
+          miss_rate = p_lo;
+          break;
+        }
+        uint64_t next_tail = tail - reuse_times[b];
+        double p_hi =
+            reuse_count ? static_cast<double>(next_tail) / reuse_count : 0;
+        double width = bucket_lo(b + 1) - bucket_lo(b);
+        double bucket_area = width * (p_lo + p_hi) / 2;
+        if (area + bucket_area >= c) {
+          // AET(c) falls into this bucket
+          double frac = bucket_area > 0 ? (c - area) / bucket_area : 0;
+          miss_rate = p_lo + (p_hi - p_lo) * frac;
+          break;
+        }
+        area += bucket_area;
+        tail = next_tail;
+        ++b;
+      }
+      uint64_t miss_cnt = std::min<uint64_t>(
+          std::llround(miss_rate * reuse_count), reuse_count);
+      caches_stat[idx].hit_cnt = reuse_count - miss_cnt;
+      caches_stat[idx].miss_cnt = miss_cnt;
+    }
+  }
+
+ public:
+  AetKvCache(uint32_t tick, uint32_t min_count, uint32_t max_count)
+      : tick(tick),
+        min_count(min_count),
+        max_count(max_count),
+        num_ticks((max_count - min_count) / tick + 1),
+        last_access(),
+        now(0),
+        reuse_times(num_buckets, 0),
+        cold_count(0),
+        reuse_count(0),
+        kv_size_sum(0),
+        caches_stat(num_ticks),
+        caches_stat_count(0) {
+    static_assert(SampleShift <= 32, "SampleShift must be no larger than 32");
+    assert(tick > 0);
+    assert(min_count + (num_ticks - 1) * tick == max_count);
+  }
+
+  void access(const std::string_view key, uint32_t kv_size) {
+    uint64_t full_hash = Hash{}(key);
+    uint32_t key_hash = full_hash;
+    // only with certain number of leading zeros is sampled
+    if constexpr (SampleShift > 0) {
+      if (key_hash >> (32 - SampleShift)) return;
+    }
+    auto [it, is_new] = last_access.try_emplace(full_hash, now);
+    if (is_new) {
+      ++cold_count;
+    } else {
+      ++reuse_times[bucket_of(now - it->second)];
+      it->second = now;
+    }
+    ++now;
+    ++reuse_count;
+    kv_size_sum += kv_size;
+  }
+
+  [[nodiscard]] uint32_t get_tick() const { return tick; }
+  [[nodiscard]] uint32_t get_min_count() const { return min_count; }
+  [[nodiscard]] uint32_t get_max_count() const { return max_count; }
+  [[nodiscard]] double get_hit_rate(uint32_t count) {
+    return get_stat(count).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t count) {
+    return get_stat(count).get_miss_rate();
+  }
+  [[nodiscard]] const CacheStat& get_stat(uint32_t count) {
+    assert(count >= min_count);
+    assert(count <= max_count);
+    assert((count - min_count) % tick == 0);
+    build_caches_stat();
+    return caches_stat[(count - min_count) / tick];
+  }
+
+  void reset_stat() {
+    cold_count = 0;
+    reuse_count = 0;
+    kv_size_sum = 0;
+    caches_stat_count = 0;
+    for (auto& n : reuse_times) n = 0;
+    for (auto& s : caches_stat) s.reset();
+  }
+
+  [[nodiscard]] const std::vector<std::tuple<
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve() {
+    std::vector<std::tuple<uint32_t, uint64_t, CacheStat>> curve;
+    build_caches_stat();
+    // like a ghost cache, only report sizes that the working set could fill
+    uint64_t distinct = last_access.size() << SampleShift;
+    double avg_kv_size =
+        reuse_count ? static_cast<double>(kv_size_sum) / reuse_count : 0;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      uint32_t count = min_count + idx * tick;
+      if (count > distinct) break;
+      curve.emplace_back(count, static_cast<uint64_t>(count * avg_kv_size),
+                         caches_stat[idx]);
+    }
+    return curve;
+  }
+};
+}  // namespace gcache
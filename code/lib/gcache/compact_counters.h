@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+namespace gcache {
+
+/**
+ * An array of counters stored 32 bits wide until one of them is about to
+ * overflow, when all of them are widened to 64 bits. The histograms of most
+ * tenants never see 2^32 accesses and keep the smaller footprint, while one
+ * replayed from a billion-request trace does not silently wrap around.
+ */
+class CompactCounters {
+  std::pmr::vector<uint32_t> narrow_;
+  std::pmr::vector<uint64_t> wide_;
+  bool is_wide_;
+
+  void widen() {
+    wide_.assign(narrow_.begin(), narrow_.end());
+    narrow_.clear();
+    narrow_.shrink_to_fit();
+    is_wide_ = true;
+  }
+
+ public:
+  explicit CompactCounters(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : narrow_(mr), wide_(mr), is_wide_(false) {}
+  CompactCounters(
+      size_t n,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : narrow_(n, 0, mr), wide_(mr), is_wide_(false) {}
+
+  [[nodiscard]] size_t size() const {
+    return is_wide_ ? wide_.size() : narrow_.size();
+  }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  [[nodiscard]] bool is_wide() const { return is_wide_; }
+
+  [[nodiscard]] uint64_t operator[](size_t i) const {
+    return is_wide_ ? wide_[i] : narrow_[i];
+  }
+
+  void increment(size_t i) {
+    if (is_wide_) {
+      ++wide_[i];
+    } else if (narrow_[i] == std::numeric_limits<uint32_t>::max()) {
+      [[unlikely]] widen();
+      ++wide_[i];
+    } else {
+      ++narrow_[i];
+    }
+  }
+
+  void set(size_t i, uint64_t v) {
+    if (!is_wide_ && v > std::numeric_limits<uint32_t>::max()) widen();
+    if (is_wide_)
+      wide_[i] = v;
+    else
+      narrow_[i] = v;
+  }
+
+  // Zero all counters; the width is kept
+  void reset() {
+    for (auto& c : narrow_) c = 0;
+    for (auto& c : wide_) c = 0;
+  }
+
+  // Grow to n counters; new ones are zero
+  void resize(size_t n) {
+    if (is_wide_)
+      wide_.resize(n, 0);
+    else
+      narrow_.resize(n, 0);
+  }
+
+  // The counters as a plain array, only while they are 32 bits wide
+  [[nodiscard]] const uint32_t* narrow_data() const {
+    assert(!is_wide_);
+    return narrow_.data();
+  }
+};
+}  // namespace gcache
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * A HyperLogLog cardinality counter with 2^Precision one-byte registers. The
+ * sum of 2^-register and the number of zero registers are kept up to date by
+ * `add`, so an estimate does not scan the registers.
+ */
+template <uint32_t Precision = 8>
+class HyperLogLog {
+ public:
+  static constexpr uint32_t num_regs = 1u << Precision;
+
+ private:
+  uint8_t regs[num_regs];
+  double sum;
+  uint32_t zeros;
+
+  // 2^-r, built from the exponent bits as std::ldexp is slow
+  static double inv_pow2(uint8_t r) {
+    return std::bit_cast<double>(uint64_t{1023u - r} << 52);
+  }
+
+ public:
+  HyperLogLog() : regs(), sum(num_regs), zeros(num_regs) {
+    static_assert(Precision >= 4 && Precision <= 16,
+                  "Precision must be within [4, 16]");
+  }
+
+  // Return whether a register went up
+  bool add(uint64_t hash) {
+    uint32_t idx = hash >> (64 - Precision);
+    // the remaining bits (plus a sentinel) decide the rank
+    uint64_t w = (hash << Precision) | (uint64_t{1} << (Precision - 1));
+    uint8_t rank = std::countl_zero(w) + 1;
+    if (rank <= regs[idx]) return false;
+    sum += inv_pow2(rank) - inv_pow2(regs[idx]);
+    if (regs[idx] == 0) --zeros;
+    regs[idx] = rank;
+    return true;
+  }
+
+  [[nodiscard]] uint32_t num_zeros() const { return zeros; }
+
+  [[nodiscard]] double estimate() const {
+    constexpr double m = num_regs;
+    constexpr double alpha = num_regs == 16   ? 0.673
+                             : num_regs == 32 ? 0.697
+                             : num_regs == 64 ? 0.709
+                                              : 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // small-range correction: fall back to linear counting
+    if (e <= 2.5 * m && zeros > 0) e = m * std::log(m / zeros);
+    return e;
+  }
+};
+
+/**
+ * Approximate the miss ratio curve of a key-value cache with counter stacks
+ * (Wires et al., OSDI'14). Instead of simulating an LRU stack, a new
+ * HyperLogLog counter is started every `interval` distinct keys; at the end of
+ * each interval, the growth of adjacent counters tells how many accesses
+ * reused a key last seen between the two counters' start times, and the older
+ * counter's cardinality approximates their reuse distance. A counter is pruned
+ * once it converges to its older neighbor (or both go beyond `max_count`), so
+ * only O(log N) counters are alive, each taking 2^Precision bytes.
+ *
+ * An older counter has seen every key a younger one has, so each of its
+ * registers is at least the younger one's: an access updates the counters
+ * from the youngest on and stops at the first one it does not change. Most
+ * accesses of a hot key touch one counter.
+ *
+ * The APIs mirror SampledGhostKvCache, so it can be used in place of it.
+ */
+template <uint32_t Precision = 10,
+          typename Hash = std::hash<std::string_view>>
+class CounterStackKvCache {
+  static constexpr uint32_t num_regs = HyperLogLog<Precision>::num_regs;
+
+  struct Counter {
+    HyperLogLog<Precision> hll;
+    double last_card;  // cardinality at the end of the previous interval
+  };
+
+  const uint32_t tick;
+  const uint32_t min_count;
+  const uint32_t max_count;
+  const uint32_t num_ticks;
+  const uint32_t interval;
+  // the youngest counter has seen `interval` keys once it has this many zero
+  // registers left, by the linear counting its estimate uses at that size
+  const uint32_t interval_zeros;
+  const double prune_delta;
+
+  // counters ordered from the oldest to the youngest
+  std::vector<Counter> counters;
+  uint64_t interval_accesses;  // accesses in the current interval
+
+  // histogram formatted the same as GhostCache::reuse_distances, but the
+  // estimation is fractional
+  std::vector<double> reuse_distances;
+  uint64_t reuse_count;
+  uint64_t kv_size_sum;  // used to convert count into size
+
+  // derived from reuse_distances on each query, which does not change the
+  // counters
+  mutable std::vector<CacheStat> caches_stat;
+
+  static uint64_t mix(uint64_t x) {  // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+
+  void add_reuse(std::vector<double>& hist, double distance,
+                 double cnt) const {
+    uint32_t size_idx =
+        distance > min_count
+            ? static_cast<uint32_t>(std::ceil((distance - min_count) / tick))
+            : 0;
+    if (size_idx < num_ticks) hist[size_idx] += cnt;
+  }
+
+  // Attribute the accesses of the current interval to reuse distances in
+  // `hist`, given each counter's cardinality now.
+  void add_interval_reuses(std::vector<double>& hist,
+                           const std::vector<double>& cards) const {
+    std::vector<double> deltas(counters.size());
+    for (size_t i = 0; i < counters.size(); ++i)
+      deltas[i] = cards[i] - counters[i].last_card;
+    // Accesses whose previous reference falls in [start_i, start_{i+1}) are
+    // counted by counter i+1 as new but not by counter i; their reuse distance
+    // lies between the two counters' cardinalities. The difference may be
+    // negative due to estimation noise; it is kept as is so the errors cancel
+    // out instead of biasing the histogram.
+    for (size_t i = 0; i + 1 < counters.size(); ++i)
+      add_reuse(hist, (cards[i] + cards[i + 1]) / 2, deltas[i + 1] - deltas[i]);
+    // Accesses reusing a key first seen within this interval
+    add_reuse(hist, cards.back() / 2, interval_accesses - deltas.back());
+  }
+
+  std::vector<double> estimate_cards() const {
+    std::vector<double> cards(counters.size());
+    for (size_t i = 0; i < counters.size(); ++i)
+      cards[i] = counters[i].hll.estimate();
+    return cards;
+  }
+
+  // Close the current interval: attribute its accesses to reuse distances,
+  // prune converged counters, and start a new counter for the next interval.
+  void end_interval() {
+    if (interval_accesses == 0) return;
+    std::vector<double> cards = estimate_cards();
+    add_interval_reuses(reuse_distances, cards);
+    for (size_t i = 0; i < counters.size(); ++i)
+      counters[i].last_card = cards[i];
+
+    // Prune counters that carry no extra information: either it converges to
+    // its older neighbor, or both are beyond the max_count so every reuse
+    // between them is a miss anyway. The oldest counter is never pruned since
+    // it tracks the total distinct keys.
+    size_t w = 1;
+    for (size_t r = 1; r < counters.size(); ++r) {
+      double older = cards[w - 1];
+      bool converged = cards[r] >= (1 - prune_delta) * older;
+      bool beyond = cards[r] > max_count && older > max_count;
+      if (converged || beyond) continue;
+      cards[w] = cards[r];
+      if (w != r) counters[w] = counters[r];
+      ++w;
+    }
+    counters.resize(w);
+    counters.emplace_back();
+    interval_accesses = 0;
+  }
+
+  // Build the stats as if the current interval ended now, but leave it open:
+  // ending it early would prune and start counters at a different time than
+  // the accesses alone would.
+  void build_caches_stat() const {
+    std::vector<double> hist = reuse_distances;
+    if (interval_accesses) add_interval_reuses(hist, estimate_cards());
+    double accum_hit_cnt = 0;
+    for (size_t idx = 0; idx < num_ticks; ++idx) {
+      accum_hit_cnt += hist[idx];
+      // the estimate may go negative due to noise; clamp before converting
+      uint64_t hit_cnt = std::llround(
+          std::clamp(accum_hit_cnt, 0.0, static_cast<double>(reuse_count)));
+      caches_stat[idx].hit_cnt = hit_cnt;
+      caches_stat[idx].miss_cnt = reuse_count - hit_cnt;
+    }
+  }
+
+ public:
+  // The interval is in distinct keys rather than accesses, so a tenant
+  // hitting a few hot keys does not close one every few accesses. If it is
+  // 0, it is derived from tick and min_count: the interval must be finer than
+  // the histogram resolution, otherwise reuses within the same interval
+  // cannot be told apart.
+  CounterStackKvCache(uint32_t tick, uint32_t min_count, uint32_t max_count,
+                      uint32_t interval = 0, double prune_delta = 0.02)
+      : tick(tick),
+        min_count(min_count),
+        max_count(max_count),
+        num_ticks((max_count - min_count) / tick + 1),
+        interval(interval ? interval
+                          : std::max(std::min(tick, min_count) / 4, 1u)),
+        interval_zeros(num_regs * std::exp(-1.0 * this->interval / num_regs)),
+        prune_delta(prune_delta),
+        counters(1),
+        interval_accesses(0),
+        reuse_distances(num_ticks, 0),
+        reuse_count(0),
+        kv_size_sum(0),
+        caches_stat(num_ticks) {
+    assert(tick > 0);
+    assert(min_count + (num_ticks - 1) * tick == max_count);
+    // beyond that, the youngest counter no longer uses linear counting
+    assert(this->interval <= num_regs);
+  }
+
+  void access(const std::string_view key, uint32_t kv_size) {
+    uint64_t key_hash = mix(Hash{}(key));
+    for (auto c = counters.rbegin(); c != counters.rend(); ++c) {
+      if (!c->hll.add(key_hash)) break;
+    }
+    kv_size_sum += kv_size;
+    ++reuse_count;
+    ++interval_accesses;
+    if (counters.back().hll.num_zeros() <= interval_zeros) end_interval();
+  }
+
+  [[nodiscard]] uint32_t get_tick() const { return tick; }
+  [[nodiscard]] uint32_t get_min_count() const { return min_count; }
+  [[nodiscard]] uint32_t get_max_count() const { return max_count; }
+  [[nodiscard]] double get_hit_rate(uint32_t count) const {
+    return get_stat(count).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t count) const {
+    return get_stat(count).get_miss_rate();
+  }
+  [[nodiscard]] const CacheStat& get_stat(uint32_t count) const {
+    assert(count >= min_count);
+    assert(count <= max_count);
+    assert((count - min_count) % tick == 0);
+    build_caches_stat();
+    return caches_stat[(count - min_count) / tick];
+  }
+
+  // Number of counters alive; memory footprint is proportional to it
+  [[nodiscard]] size_t num_counters() const { return counters.size(); }
+
+  void reset_stat() {
+    // the accesses of the open interval belong to the stats being reset
+    end_interval();
+    reuse_count = 0;
+    kv_size_sum = 0;
+    for (auto& d : reuse_distances) d = 0;
+  }
+
+  [[nodiscard]] const std::vector<std::tuple<
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve() const {
+    std::vector<std::tuple<uint32_t, uint64_t, CacheStat>> curve;
+    build_caches_stat();
+    // like a ghost cache, only report sizes that the working set could fill
+    double distinct = counters.front().hll.estimate();
+    double avg_kv_size =
+        reuse_count ? static_cast<double>(kv_size_sum) / reuse_count : 0;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      uint32_t count = min_count + idx * tick;
+      if (count > distinct) break;
+      curve.emplace_back(count, static_cast<uint64_t>(count * avg_kv_size),
+                         caches_stat[idx]);
+    }
+    return curve;
+  }
+};
+}  // namespace gcache
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * Allocation policies for SharedCache's fair-share mode: each splits `total`
+ * slots among tenants (in the order given) into targets for
+ * SharedCache::set_targets. The targets always sum to `total`.
+ *
+ * The curve-driven policies take each tenant's curve as returned by
+ * get_cache_stat_curve of a ghost cache, i.e., (count, size, stat) points in
+ * ascending count; a tenant has no hits at zero slots.
+ */
+using StatCurve = std::vector<std::tuple<uint32_t, uint64_t, CacheStat>>;
+
+// Split in proportion to `weights`, rounding by the largest remainder; equal
+// shares if no weight is positive.
+inline std::vector<size_t> weighted_shares(size_t total,
+                                           const std::vector<double>& weights) {
+  size_t n = weights.size();
+  std::vector<size_t> shares(n);
+  if (!n) return shares;
+  double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+  std::vector<std::pair<double, size_t>> remainders;
+  remainders.reserve(n);
+  size_t given = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double exact = sum > 0 ? total * (weights[i] / sum) : double(total) / n;
+    shares[i] = std::min<size_t>(std::floor(exact), total - given);
+    given += shares[i];
+    remainders.emplace_back(exact - shares[i], i);
+  }
+  std::stable_sort(remainders.begin(), remainders.end(),
+                   [](auto& a, auto& b) { return a.first > b.first; });
+  for (size_t j = 0; given < total; j = (j + 1) % n, ++given)
+    ++shares[remainders[j].second];
+  return shares;
+}
+
+// Max-min fairness (or DRF, with slots as the only resource) on demands:
+// water-fill, so no tenant gets more than it asks for unless every demand is
+// met, and the slots left over are split equally.
+inline std::vector<size_t> demand_shares(size_t total,
+                                         const std::vector<size_t>& demands) {
+  size_t n = demands.size();
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return demands[a] < demands[b]; });
+  std::vector<size_t> shares(n);
+  size_t left = total;
+  for (size_t k = 0; k < n; ++k) {
+    size_t i = order[k];
+    shares[i] = std::min(demands[i], left / (n - k));
+    left -= shares[i];
+  }
+  auto extra = weighted_shares(left, std::vector<double>(n, 1));
+  for (size_t i = 0; i < n; ++i) shares[i] += extra[i];
+  return shares;
+}
+
+// Guarantee each tenant `reserved` slots and split the shared pool left by
+// `weights`; if the reservations exceed `total`, they are scaled down.
+inline std::vector<size_t> reserved_shares(size_t total,
+                                           const std::vector<size_t>& reserved,
+                                           const std::vector<double>& weights) {
+  size_t sum = std::accumulate(reserved.begin(), reserved.end(), size_t{0});
+  if (sum >= total) {
+    return weighted_shares(
+        total, std::vector<double>(reserved.begin(), reserved.end()));
+  }
+  auto shares = weighted_shares(total - sum, weights);
+  for (size_t i = 0; i < shares.size(); ++i) shares[i] += reserved[i];
+  return shares;
+}
+
+// Max-min fairness on hit rate: repeatedly move the tenant with the lowest hit
+// rate to its next point that still fits; the slots left over are split
+// equally. A tenant with no accesses gets no more than its equal part of them.
+inline std::vector<size_t> max_min_hit_rate_shares(
+    size_t total, const std::vector<StatCurve>& curves) {
+  size_t n = curves.size();
+  std::vector<size_t> shares(n);
+  std::vector<size_t> next(n);  // index of each tenant's next point
+  std::vector<double> hit_rates(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (curves[i].empty()) continue;
+    const CacheStat& s = std::get<2>(curves[i].front());
+    // no hits at zero slots; "infinite" if it has no accesses
+    hit_rates[i] = s.hit_cnt + s.miss_cnt ? 0 : s.get_hit_rate();
+  }
+  size_t left = total;
+  for (;;) {
+    size_t lowest = n;
+    for (size_t i = 0; i < n; ++i) {
+      if (std::isinf(hit_rates[i]) || next[i] == curves[i].size() ||
+          std::get<0>(curves[i][next[i]]) > shares[i] + left)
+        continue;
+      if (lowest == n || hit_rates[i] < hit_rates[lowest]) lowest = i;
+    }
+    if (lowest == n) break;
+    auto& [count, size, stat] = curves[lowest][next[lowest]++];
+    left -= count - shares[lowest];
+    shares[lowest] = count;
+    hit_rates[lowest] = stat.get_hit_rate();
+  }
+  auto extra = weighted_shares(left, std::vector<double>(n, 1));
+  for (size_t i = 0; i < n; ++i) shares[i] += extra[i];
+  return shares;
+}
+
+// Maximize the total hits: repeatedly move the tenant with the most hits
+// gained per slot to whichever further point of its curve gains the most per
+// slot and still fits, looking past non-concave parts of the curve as
+// utility-based cache partitioning does; the slots left over are split
+// equally.
+inline std::vector<size_t> utility_shares(
+    size_t total, const std::vector<StatCurve>& curves) {
+  size_t n = curves.size();
+  std::vector<size_t> shares(n);
+  std::vector<size_t> next(n);
+  std::vector<uint64_t> hits(n);
+  size_t left = total;
+  for (;;) {
+    size_t best = n;
+    size_t best_point = 0;
+    double best_gain = 0;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = next[i]; j < curves[i].size(); ++j) {
+        auto& [count, size, stat] = curves[i][j];
+        if (count > shares[i] + left) break;
+        if (count <= shares[i] || stat.hit_cnt <= hits[i]) continue;
+        double gain = double(stat.hit_cnt - hits[i]) / (count - shares[i]);
+        if (gain > best_gain) {
+          best = i;
+          best_point = j;
+          best_gain = gain;
+        }
+      }
+    }
+    if (best == n) break;
+    auto& [count, size, stat] = curves[best][best_point];
+    left -= count - shares[best];
+    shares[best] = count;
+    hits[best] = stat.hit_cnt;
+    next[best] = best_point + 1;
+  }
+  auto extra = weighted_shares(left, std::vector<double>(n, 1));
+  for (size_t i = 0; i < n; ++i) shares[i] += extra[i];
+  return shares;
+}
+
+}  // namespace gcache
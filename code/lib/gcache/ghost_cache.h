@@ -1,12 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <type_traits>
 #include <vector>
 
+#include "compact_counters.h"
 #include "hash.h"
 #include "lru_cache.h"
 #include "node.h"
+#include "prefix_sum.h"
+#include "reuse_histogram.h"
 #include "stat.h"
 
 namespace gcache {
@@ -19,9 +27,42 @@ enum AccessMode : uint8_t {
   NOOP,     // do not update
 };
 
+// StatWindow selects which part of the access history a stat covers
+enum class StatWindow : uint8_t {
+  CUMULATIVE,  // all accesses since the last `reset_stat`
+  WINDOW,      // accesses between the last two `roll_window`
+  DECAYED,     // all windows, weighted by decay^(age in windows)
+};
+
 struct GhostMeta {
   uint32_t size_idx;
 };
+template <>
+inline constexpr bool node_has_size<GhostMeta> = false;
+
+/**
+ * Header of a GhostCache snapshot (see `GhostCache::save`). It is followed by
+ * 8-byte aligned sections: the reuse distance histogram (64-bit counters
+ * regardless of the width held in memory); if any window has
+ * been rolled, the window base, decayed histogram, window stat and decayed
+ * stat; then (key, hash, Meta) of every handle in LRU order. The layout has no
+ * pointers, so a snapshot can be restored directly from an mmap-ed file.
+ */
+struct GhostSnapshotHeader {
+  static constexpr uint32_t kMagic = 0x47534e32;  // "GSN2"
+
+  uint32_t magic;
+  uint32_t meta_size;  // sizeof(Meta), to reject a snapshot of another Meta
+  uint32_t tick;
+  uint32_t min_size;
+  uint32_t max_size;
+  uint32_t num_ticks;
+  uint32_t num_handles;
+  uint32_t has_window;
+  uint64_t reuse_count;
+  uint64_t window_base_count;
+  double decayed_count;
+};
 
 template <typename Hash>
 class GhostKvCache;
@@ -51,12 +92,26 @@ class GhostCache {
 
  protected:
   // these must be placed after num_ticks to ensure a correct ctor order
-  std::vector<Node_t*> boundaries;
-  std::vector<CacheStat> caches_stat;
-
-  // the reused distances are formatted as a histogram
-  std::vector<uint32_t> reuse_distances;  // converted to caches_stat lazily
-  uint32_t reuse_count;                   // count all access to reuse_distances
+  std::pmr::vector<Node_t*> boundaries;
+  std::pmr::vector<CacheStat> caches_stat;
+
+  // the reused distances are formatted as a histogram; converted to
+  // caches_stat lazily. The counters are 32-bit until one would overflow.
+  CompactCounters reuse_distances;
+  uint64_t reuse_count;  // count all access to reuse_distances
+  // hit count of each cache size, i.e., reuse_distances prefix-summed; kept
+  // apart from caches_stat so the sum runs over a contiguous array. Only
+  // used while reuse_count fits in 32 bits, which bounds every sum.
+  std::pmr::vector<uint32_t> accum_hits;
+
+  // windowed views of the histogram; only allocated after the first
+  // `roll_window`, and built eagerly there since it is called rarely
+  CompactCounters window_base;  // reuse_distances at window begins
+  uint64_t window_base_count;
+  std::pmr::vector<CacheStat> window_stat;
+  std::pmr::vector<double> decayed_distances;
+  double decayed_count;
+  std::pmr::vector<CacheStat> decayed_stat;
 
   Handle_t access_impl(uint32_t block_id, uint32_t hash, AccessMode mode);
 
@@ -65,17 +120,73 @@ class GhostCache {
 
   void build_caches_stat();
 
+  // All points of a stat at once, for assembling a whole curve in one pass;
+  // the cumulative stat is built if stale. nullptr if `window` is not
+  // CUMULATIVE and no window has been closed yet.
+  const CacheStat* get_stats(StatWindow window) {
+    if (window != StatWindow::CUMULATIVE) {
+      if (window_stat.empty()) return nullptr;
+      return window == StatWindow::WINDOW ? window_stat.data()
+                                          : decayed_stat.data();
+    }
+    if (caches_stat[0].hit_cnt + caches_stat[0].miss_cnt != reuse_count)
+      build_caches_stat();
+    return caches_stat.data();
+  }
+
+  static constexpr size_t snapshot_align(size_t n) {
+    return (n + 7) & ~size_t{7};
+  }
+  static constexpr size_t snapshot_handle_size =
+      2 * sizeof(uint32_t) + sizeof(Meta);
+  template <typename T>
+  static char* snapshot_put(char* p, const T* src, size_t n) {
+    size_t len = n * sizeof(T);
+    std::memcpy(p, src, len);
+    std::memset(p + len, 0, snapshot_align(len) - len);
+    return p + snapshot_align(len);
+  }
+  template <typename T>
+  static const char* snapshot_get(const char* p, T* dst, size_t n) {
+    std::memcpy(dst, p, n * sizeof(T));
+    return p + snapshot_align(n * sizeof(T));
+  }
+  static char* snapshot_put(char* p, const CompactCounters& src) {
+    for (size_t i = 0; i < src.size(); ++i) {
+      uint64_t c = src[i];
+      std::memcpy(p + i * sizeof(uint64_t), &c, sizeof(uint64_t));
+    }
+    return p + src.size() * sizeof(uint64_t);
+  }
+  static const char* snapshot_get(const char* p, CompactCounters& dst) {
+    for (size_t i = 0; i < dst.size(); ++i) {
+      uint64_t c;
+      std::memcpy(&c, p + i * sizeof(uint64_t), sizeof(uint64_t));
+      dst.set(i, c);
+    }
+    return p + dst.size() * sizeof(uint64_t);
+  }
+
  public:
-  GhostCache(uint32_t tick, uint32_t min_size, uint32_t max_size)
+  // All memory (LRU handles, table, and histograms) is allocated from `mr`
+  GhostCache(uint32_t tick, uint32_t min_size, uint32_t max_size,
+             std::pmr::memory_resource* mr = std::pmr::get_default_resource())
       : tick(tick),
         min_size(min_size),
         max_size(max_size),
         num_ticks((max_size - min_size) / tick + 1),
-        cache(),
-        boundaries(num_ticks - 1, nullptr),
-        caches_stat(num_ticks),
-        reuse_distances(num_ticks, 0),
-        reuse_count(0) {
+        cache(mr),
+        boundaries(num_ticks - 1, nullptr, mr),
+        caches_stat(num_ticks, mr),
+        reuse_distances(num_ticks, mr),
+        reuse_count(0),
+        accum_hits(num_ticks, 0, mr),
+        window_base(mr),
+        window_base_count(0),
+        window_stat(mr),
+        decayed_distances(mr),
+        decayed_count(0),
+        decayed_stat(mr) {
     assert(tick > 0);
     assert(min_size > 1);  // otherwise the first boundary will be LRU evicted
     assert(min_size + (num_ticks - 1) * tick == max_size);
@@ -91,12 +202,20 @@ class GhostCache {
   [[nodiscard]] uint32_t get_min_size() const { return min_size; }
   [[nodiscard]] uint32_t get_max_size() const { return max_size; }
 
-  [[nodiscard]] const CacheStat& get_stat(uint32_t cache_size) {
+  [[nodiscard]] const CacheStat& get_stat(
+      uint32_t cache_size, StatWindow window = StatWindow::CUMULATIVE) {
     assert(cache_size >= min_size);
     assert(cache_size <= max_size);
     assert((cache_size - min_size) % tick == 0);
     uint32_t size_idx = (cache_size - min_size) / tick;
     assert(size_idx < num_ticks);
+    if (window != StatWindow::CUMULATIVE) {
+      // no window has been closed yet
+      static const CacheStat empty_stat;
+      if (window_stat.empty()) return empty_stat;
+      return window == StatWindow::WINDOW ? window_stat[size_idx]
+                                          : decayed_stat[size_idx];
+    }
     const CacheStat& stat = caches_stat[size_idx];
     if (stat.hit_cnt + stat.miss_cnt != reuse_count) build_caches_stat();
     assert(stat.hit_cnt + stat.miss_cnt == reuse_count);
@@ -111,9 +230,43 @@ class GhostCache {
 
   void reset_stat() {
     reuse_count = 0;
-    for (size_t i = 0; i < reuse_distances.size(); ++i) reuse_distances[i] = 0;
+    reuse_distances.reset();
+    window_base_count = 0;
+    window_base.reset();
   }
 
+  // Close the current window: the accesses since the previous call form the
+  // new window, and are added to the decayed histogram after the older
+  // windows are scaled by `decay`. Cost is O(num_ticks).
+  void roll_window(double decay);
+
+  // The cumulative histogram at tick resolution: bucket i holds the accesses
+  // that hit with min_size + i * tick blocks but miss with one tick less.
+  [[nodiscard]] ReuseHistogram get_reuse_histogram() const {
+    ReuseHistogram h;
+    for (uint32_t i = 0; i < num_ticks; ++i) {
+      h.bounds.push_back(min_size + i * tick);
+      h.counts.push_back(reuse_distances[i]);
+    }
+    h.total = reuse_count;
+    return h;
+  }
+
+  // Size in bytes of the snapshot written by `save`.
+  [[nodiscard]] size_t snapshot_size() const;
+
+  // Serialize the full state (LRU order, size_idx and the rest of Meta of
+  // each handle, and all histograms) into `buf` of `snapshot_size()` bytes.
+  // Cost is O(size + num_ticks); stats are not rebuilt.
+  void save(char* buf) const;
+
+  // Restore the state saved by `save` into a freshly constructed cache with
+  // the same tick/min_size/max_size; return false (and leave the cache
+  // untouched) if the snapshot does not match or is cut short of its `len`
+  // bytes. `buf` may point into an mmap-ed file and is not referenced after
+  // return.
+  bool load(const char* buf, size_t len);
+
   // For each item in the LRU list, call fn in LRU order
   template <typename Fn>
   void for_each_lru(Fn&& fn) const {
@@ -157,6 +310,12 @@ class GhostCache {
   void unsafe_for_each_until_mru(Fn&& fn) const {
     cache.for_each_until_mru(fn);
   }
+  // in no particular order; much faster than walking the lru list once the
+  // cache is mostly full since it scans the handle pool sequentially
+  template <typename Fn>
+  void unsafe_for_each(Fn&& fn) const {
+    cache.for_each(fn);
+  }
 
  public:
   std::ostream& print(std::ostream& os, int indent = 0);
@@ -170,9 +329,11 @@ template <uint32_t SampleShift = 5, typename Hash = ghash,
           typename Meta = GhostMeta>
 class SampledGhostCache : public GhostCache<Hash, Meta> {
  public:
-  SampledGhostCache(uint32_t tick, uint32_t min_size, uint32_t max_size)
+  SampledGhostCache(
+      uint32_t tick, uint32_t min_size, uint32_t max_size,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
       : GhostCache<Hash, Meta>(tick >> SampleShift, min_size >> SampleShift,
-                               max_size >> SampleShift) {
+                               max_size >> SampleShift, mr) {
     static_assert(SampleShift <= 32, "SampleShift must be no larger than 32");
     assert(tick % (1 << SampleShift) == 0);
     assert(min_size % (1 << SampleShift) == 0);
@@ -201,8 +362,16 @@ class SampledGhostCache : public GhostCache<Hash, Meta> {
     return this->max_size << SampleShift;
   }
 
-  [[nodiscard]] const CacheStat& get_stat(uint32_t cache_size) {
-    return get_stat_shifted(cache_size >> SampleShift);
+  [[nodiscard]] const CacheStat& get_stat(
+      uint32_t cache_size, StatWindow window = StatWindow::CUMULATIVE) {
+    return get_stat_shifted(cache_size >> SampleShift, window);
+  }
+
+  // Bounds are scaled back to unsampled blocks
+  [[nodiscard]] ReuseHistogram get_reuse_histogram() const {
+    ReuseHistogram h = GhostCache<Hash, Meta>::get_reuse_histogram();
+    for (auto& b : h.bounds) b <<= SampleShift;
+    return h;
   }
   [[nodiscard]] double get_hit_rate(uint32_t cache_size) {
     return this->get_stat(cache_size).get_hit_rate();
@@ -215,8 +384,10 @@ class SampledGhostCache : public GhostCache<Hash, Meta> {
   template <uint32_t S, typename H>
   friend class SampledGhostKvCache;
 
-  [[nodiscard]] const CacheStat& get_stat_shifted(uint32_t cache_size_shifted) {
-    return GhostCache<Hash, Meta>::get_stat(cache_size_shifted);
+  [[nodiscard]] const CacheStat& get_stat_shifted(
+      uint32_t cache_size_shifted,
+      StatWindow window = StatWindow::CUMULATIVE) {
+    return GhostCache<Hash, Meta>::get_stat(cache_size_shifted, window);
   }
 };
 
@@ -285,14 +456,14 @@ GhostCache<Hash, Meta>::access_impl(uint32_t block_id, uint32_t hash,
   switch (mode) {
     case AccessMode::DEFAULT:
       // if no successor,it must be a miss for all cache sizes
-      if (s) ++reuse_distances[size_idx];
+      if (s) reuse_distances.increment(size_idx);
       ++reuse_count;
       break;
     case AccessMode::AS_MISS:
       ++reuse_count;
       break;
     case AccessMode::AS_HIT:
-      ++reuse_distances[0];
+      reuse_distances.increment(0);
       ++reuse_count;
       break;
     case AccessMode::NOOP:
@@ -303,14 +474,154 @@ GhostCache<Hash, Meta>::access_impl(uint32_t block_id, uint32_t hash,
 
 template <typename Hash, typename Meta>
 inline void GhostCache<Hash, Meta>::build_caches_stat() {
-  uint32_t accum_hit_cnt = 0;
-  for (size_t idx = 0; idx < caches_stat.size(); ++idx) {
+  // no prefix sum exceeds reuse_count, so the 32-bit kernel is exact as long
+  // as it fits; past that, sum in 64 bits. The counters stay wide once
+  // widened, even after `reset_stat` or `load` brings reuse_count back down.
+  if (!reuse_distances.is_wide() && reuse_count <= UINT32_MAX) {
+    prefix_sum(reuse_distances.narrow_data(), accum_hits.data(), num_ticks);
+    for (size_t idx = 0; idx < num_ticks; ++idx) {
+      caches_stat[idx].hit_cnt = accum_hits[idx];
+      caches_stat[idx].miss_cnt = reuse_count - accum_hits[idx];
+    }
+    return;
+  }
+  uint64_t accum_hit_cnt = 0;
+  for (size_t idx = 0; idx < num_ticks; ++idx) {
     accum_hit_cnt += reuse_distances[idx];
     caches_stat[idx].hit_cnt = accum_hit_cnt;
     caches_stat[idx].miss_cnt = reuse_count - accum_hit_cnt;
   }
 }
 
+template <typename Hash, typename Meta>
+inline void GhostCache<Hash, Meta>::roll_window(double decay) {
+  assert(decay >= 0 && decay < 1);
+  if (window_base.empty()) {
+    window_base.resize(num_ticks);
+    window_stat.resize(num_ticks);
+    decayed_distances.resize(num_ticks, 0);
+    decayed_stat.resize(num_ticks);
+  }
+  uint64_t window_count = reuse_count - window_base_count;
+  decayed_count = decay * decayed_count + window_count;
+  uint64_t accum_hit_cnt = 0;
+  double accum_decayed_hit_cnt = 0;
+  for (size_t idx = 0; idx < num_ticks; ++idx) {
+    uint64_t delta = reuse_distances[idx] - window_base[idx];
+    window_base.set(idx, reuse_distances[idx]);
+    accum_hit_cnt += delta;
+    window_stat[idx].hit_cnt = accum_hit_cnt;
+    window_stat[idx].miss_cnt = window_count - accum_hit_cnt;
+
+    decayed_distances[idx] = decay * decayed_distances[idx] + delta;
+    accum_decayed_hit_cnt += decayed_distances[idx];
+    uint64_t decayed_hit_cnt = std::llround(accum_decayed_hit_cnt);
+    uint64_t decayed_acc_cnt = std::llround(decayed_count);
+    decayed_stat[idx].hit_cnt = std::min(decayed_hit_cnt, decayed_acc_cnt);
+    decayed_stat[idx].miss_cnt =
+        decayed_acc_cnt - decayed_stat[idx].hit_cnt;
+  }
+  window_base_count = reuse_count;
+}
+
+template <typename Hash, typename Meta>
+inline size_t GhostCache<Hash, Meta>::snapshot_size() const {
+  size_t n = sizeof(GhostSnapshotHeader) + num_ticks * sizeof(uint64_t);
+  if (!window_base.empty())
+    n += num_ticks * sizeof(uint64_t) +
+         num_ticks * (sizeof(double) + 2 * sizeof(CacheStat));
+  return n + snapshot_align(cache.size() * snapshot_handle_size);
+}
+
+template <typename Hash, typename Meta>
+inline void GhostCache<Hash, Meta>::save(char* buf) const {
+  static_assert(std::is_trivially_copyable_v<Meta>);
+  GhostSnapshotHeader hdr{GhostSnapshotHeader::kMagic,
+                          sizeof(Meta),
+                          tick,
+                          min_size,
+                          max_size,
+                          num_ticks,
+                          static_cast<uint32_t>(cache.size()),
+                          !window_base.empty(),
+                          reuse_count,
+                          window_base_count,
+                          decayed_count};
+  char* p = snapshot_put(buf, &hdr, 1);
+  p = snapshot_put(p, reuse_distances);
+  if (hdr.has_window) {
+    p = snapshot_put(p, window_base);
+    p = snapshot_put(p, decayed_distances.data(), num_ticks);
+    p = snapshot_put(p, window_stat.data(), num_ticks);
+    p = snapshot_put(p, decayed_stat.data(), num_ticks);
+  }
+  char* begin = p;
+  cache.for_each_lru([&p](Node_t* h) {
+    std::memcpy(p, &h->key, sizeof(uint32_t));
+    std::memcpy(p + sizeof(uint32_t), &h->hash, sizeof(uint32_t));
+    std::memcpy(p + 2 * sizeof(uint32_t), &h->value, sizeof(Meta));
+    p += snapshot_handle_size;
+  });
+  size_t len = p - begin;
+  std::memset(p, 0, snapshot_align(len) - len);
+}
+
+template <typename Hash, typename Meta>
+inline bool GhostCache<Hash, Meta>::load(const char* buf, size_t len) {
+  assert(cache.size() == 0);
+  GhostSnapshotHeader hdr;
+  if (len < sizeof(hdr)) return false;
+  const char* p = snapshot_get(buf, &hdr, 1);
+  if (hdr.magic != GhostSnapshotHeader::kMagic ||
+      hdr.meta_size != sizeof(Meta) || hdr.tick != tick ||
+      hdr.min_size != min_size || hdr.max_size != max_size ||
+      hdr.num_ticks != num_ticks || hdr.num_handles > max_size ||
+      hdr.has_window > 1)
+    return false;
+  // the same layout as `snapshot_size`, but of the snapshot's own content
+  size_t expected = sizeof(hdr) + num_ticks * sizeof(uint64_t);
+  if (hdr.has_window)
+    expected += num_ticks * sizeof(uint64_t) +
+                num_ticks * (sizeof(double) + 2 * sizeof(CacheStat));
+  expected += size_t{hdr.num_handles} * snapshot_handle_size;
+  if (len < expected) return false;
+
+  p = snapshot_get(p, reuse_distances);
+  reuse_count = hdr.reuse_count;
+  window_base_count = hdr.window_base_count;
+  decayed_count = hdr.decayed_count;
+  if (hdr.has_window) {
+    window_base.resize(num_ticks);
+    decayed_distances.resize(num_ticks);
+    window_stat.resize(num_ticks);
+    decayed_stat.resize(num_ticks);
+    p = snapshot_get(p, window_base);
+    p = snapshot_get(p, decayed_distances.data(), num_ticks);
+    p = snapshot_get(p, window_stat.data(), num_ticks);
+    p = snapshot_get(p, decayed_stat.data(), num_ticks);
+  }
+
+  // Inserting in LRU order rebuilds the list; each handle then gets back its
+  // size_idx, so boundary i is the least recent handle with size_idx i, but
+  // only once the cache has grown to the size the boundary stands for.
+  for (uint32_t i = 0; i < hdr.num_handles; ++i) {
+    uint32_t key, hash;
+    std::memcpy(&key, p, sizeof(uint32_t));
+    std::memcpy(&hash, p + sizeof(uint32_t), sizeof(uint32_t));
+    Handle_t s;
+    Handle_t h = cache.refresh(key, hash, s);
+    assert(h && !s);
+    std::memcpy(&h.node->value, p + 2 * sizeof(uint32_t), sizeof(Meta));
+    uint32_t size_idx = h->size_idx;
+    if (size_idx < num_ticks - 1 && !boundaries[size_idx] &&
+        hdr.num_handles >= min_size + size_idx * tick)
+      boundaries[size_idx] = h.node;
+    p += snapshot_handle_size;
+  }
+  for (auto& stat : caches_stat) stat.reset();
+  return true;
+}
+
 template <typename Hash, typename Meta>
 inline std::ostream& GhostCache<Hash, Meta>::print(std::ostream& os,
                                                    int indent) {
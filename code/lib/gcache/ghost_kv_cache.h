@@ -1,10 +1,13 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <memory_resource>
 #include <string_view>
 
 #include <gcache/stat.h>
 
 #include "ghost_cache.h"
+#include "prefix_sum.h"
 
 namespace gcache {
 
@@ -12,6 +15,8 @@ struct GhostKvMeta {
   uint32_t size_idx;
   uint32_t kv_size;
 };
+template <>
+inline constexpr bool node_has_size<GhostKvMeta> = false;
 
 /**
  * Simulate a key-value cache. It differs from GhostCache in that the key-value
@@ -21,6 +26,25 @@ struct GhostKvMeta {
 template <uint32_t SampleShift = 5, typename Hash = std::hash<std::string_view>>
 class SampledGhostKvCache {
   SampledGhostCache<SampleShift, idhash, GhostKvMeta> ghost_cache;
+  // total kv size of the `min_size + i * tick` most recent handles; only
+  // rebuilt for the first curve after an access, so the cumulative and
+  // windowed curves of a checkpoint share one scan. 64-bit, since sampled
+  // sizes are scaled back up by 2^SampleShift.
+  std::pmr::vector<uint64_t> accum_sizes;
+  bool accum_sizes_stale;
+
+  void build_accum_sizes() {
+    // A handle's size_idx is exactly which tick its MRU position falls into,
+    // so the total size of the `min_size + i * tick` most recent handles is
+    // a prefix sum of per-size_idx totals; these can be collected by
+    // scanning the pool sequentially instead of walking the list in MRU
+    // order.
+    std::fill(accum_sizes.begin(), accum_sizes.end(), 0);
+    ghost_cache.unsafe_for_each(
+        [&](Handle_t h) { accum_sizes[h->size_idx] += h->kv_size; });
+    prefix_sum(accum_sizes.data(), accum_sizes.data(), accum_sizes.size());
+    accum_sizes_stale = false;
+  }
 
  public:
   using Handle_t =
@@ -29,8 +53,12 @@ class SampledGhostKvCache {
       typename SampledGhostCache<SampleShift, idhash, GhostKvMeta>::Node_t;
 
  public:
-  SampledGhostKvCache(uint32_t tick, uint32_t min_count, uint32_t max_count)
-      : ghost_cache(tick, min_count, max_count) {
+  SampledGhostKvCache(
+      uint32_t tick, uint32_t min_count, uint32_t max_count,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : ghost_cache(tick, min_count, max_count, mr),
+        accum_sizes(ghost_cache.num_ticks, 0, mr),
+        accum_sizes_stale(true) {
     static_assert(SampleShift <= 32, "SampleShift must be no larger than 32");
   }
 
@@ -48,6 +76,7 @@ class SampledGhostKvCache {
     }
     auto h = ghost_cache.access_impl(key_hash, key_hash, mode);
     h->kv_size = kv_size;
+    accum_sizes_stale = true;
   }
 
   // for compatibility with GhostCache: APIs to query by keys count
@@ -64,12 +93,31 @@ class SampledGhostKvCache {
   [[nodiscard]] double get_miss_rate(uint32_t count) {
     return ghost_cache.get_miss_rate(count);
   }
-  [[nodiscard]] const CacheStat& get_stat(uint32_t count) {
-    return ghost_cache.get_stat(count);
+  [[nodiscard]] const CacheStat& get_stat(
+      uint32_t count, StatWindow window = StatWindow::CUMULATIVE) {
+    return ghost_cache.get_stat(count, window);
   }
 
   void reset_stat() { ghost_cache.reset_stat(); }
 
+  // Close the current window of stat; see GhostCache::roll_window
+  void roll_window(double decay) { ghost_cache.roll_window(decay); }
+
+  // Reuse distance histogram in keys; see GhostCache::get_reuse_histogram
+  [[nodiscard]] ReuseHistogram get_reuse_histogram() const {
+    return ghost_cache.get_reuse_histogram();
+  }
+
+  // Snapshot and restore; see GhostCache::save and GhostCache::load
+  [[nodiscard]] size_t snapshot_size() const {
+    return ghost_cache.snapshot_size();
+  }
+  void save(char* buf) const { ghost_cache.save(buf); }
+  bool load(const char* buf, size_t len) {
+    accum_sizes_stale = true;
+    return ghost_cache.load(buf, len);
+  }
+
   // For each item in the LRU list, call fn in LRU order
   template <typename Fn>
   void for_each_lru(Fn&& fn) const {
@@ -95,20 +143,23 @@ class SampledGhostKvCache {
   }
 
   [[nodiscard]] const std::vector<std::tuple<
-      /*count*/ uint32_t, /*size*/ uint32_t, /*miss_rate*/ CacheStat>>
-  get_cache_stat_curve() {
-    std::vector<std::tuple<uint32_t, uint32_t, CacheStat>> curve;
-    uint32_t curr_count = 0;
-    uint32_t curr_size = 0;
-    ghost_cache.unsafe_for_each_mru([&](Handle_t h) {
-      curr_size += h->kv_size;
-      ++curr_count;
-      if (curr_count >= ghost_cache.min_size &&
-          (curr_count - ghost_cache.min_size) % ghost_cache.tick == 0) {
-        curve.emplace_back(curr_count << SampleShift, curr_size << SampleShift,
-                           ghost_cache.get_stat_shifted(curr_count));
-      }
-    });
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve(StatWindow window = StatWindow::CUMULATIVE) {
+    std::vector<std::tuple<uint32_t, uint64_t, CacheStat>> curve;
+    if (accum_sizes_stale) build_accum_sizes();
+    // stats of all points at once instead of a lookup per point
+    const CacheStat* stats = ghost_cache.get_stats(window);
+    static const CacheStat empty_stat;
+    uint32_t num_handles = ghost_cache.cache.size();
+    uint32_t num_ticks = ghost_cache.num_ticks;
+    curve.reserve(num_ticks);
+    for (uint32_t i = 0; i < num_ticks; ++i) {
+      uint32_t curr_count = ghost_cache.min_size + i * ghost_cache.tick;
+      if (curr_count > num_handles) break;
+      curve.emplace_back(curr_count << SampleShift,
+                         accum_sizes[i] << SampleShift,
+                         stats ? stats[i] : empty_stat);
+    }
     return curve;
     // should be implicitly moved by compiler
     // avoid explict move for Return Value Optimization (RVO)
@@ -3,11 +3,15 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
 #include <vector>
 
 #include "node.h"
@@ -18,12 +22,13 @@ namespace gcache {
 template <typename Hash, typename Meta>
 class GhostCache;
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-class SharedCache;
+template <uint32_t Tick, uint32_t MinSize, uint32_t MaxSize, typename Hash,
+          typename Meta>
+class StaticGhostCache;
 
 // Key_t should be lightweight that can be pass-by-value
 // Value_t should be trivially copyable
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 class LRUCache {
   /**
    * Note the values are initialized once and never destructed during the
@@ -38,13 +43,30 @@ class LRUCache {
    * the new block number, but the value field remains the same pointer. This is
    * a fundamentally different from a key-value map, where the value's lifecycle
    * is binded to the key.
+   *
+   * With Mode = EvictMode::CLOCK, a hit on an unpinned node only sets its
+   * reference bit instead of relinking it, which saves writing the node's and
+   * both neighbors' links on the hit path of read-heavy workloads; eviction
+   * then moves referenced nodes from the oldest end to the newest end (with
+   * the bit cleared) until it finds an unreferenced one. This is CLOCK with
+   * the LRU list as the clock and its oldest end as the hand; the lists,
+   * pinning, and the rest of the API work the same in both modes.
+   *
+   * Capacity is counted in nodes (slots) by default. After `init_bytes`, the
+   * total size of the objects is also bounded by a byte capacity: each node
+   * carries the size its object was inserted with, and an insertion evicts
+   * until both a node and enough bytes are free. The nodes still come from
+   * the pool, so the node count only bounds the number of objects.
    */
 
  public:
   using Node_t = LRUNode<Key_t, Value_t>;
   using Handle_t = LRUHandle<Key_t, Value_t>;
 
-  LRUCache();
+  // The handle pool and table are allocated from `mr`, which must outlive
+  // the cache; e.g., an Arena packs many small caches contiguously.
+  explicit LRUCache(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource());
   ~LRUCache();
   LRUCache(const LRUCache&) = delete;
   LRUCache(LRUCache&&) = delete;
@@ -53,14 +75,30 @@ class LRUCache {
   void init(size_t capacity);
   template <typename Fn>
   void init(size_t capacity, Fn&& fn);
+  // Same as `init`, but the objects' total size is bounded by `byte_capacity`
+  void init_bytes(size_t capacity, size_t byte_capacity);
 
   size_t size() const { return size_; }
   size_t capacity() const { return capacity_; }
-
-  // For each item in the cache, call fn(key, handle)
+  // Total size of the objects in the cache
+  size_t size_bytes() const { return bytes_; }
+  // Unbounded (the max of size_t) unless initialized by `init_bytes`
+  size_t capacity_bytes() const { return byte_capacity_; }
+  // Number of objects evicted so far, to make room or ahead of time
+  uint64_t num_evicted() const { return num_evicted_; }
+
+  // For each item in the cache, call fn(key, handle) in no particular order
   template <typename Fn>
   void for_each(Fn&& fn) const;
 
+  // For each item in the cache, call fn(key, handle) in the order the handles
+  // are laid out in memory: a sequential scan of the pool streams at memory
+  // bandwidth, while walking a list is a dependent cache miss per handle once
+  // the cache outgrows the CPU caches. Free and erased handles are skipped.
+  // Only available if initialized by `init` (i.e., the pool is owned).
+  template <typename Fn>
+  void for_each_pool(Fn&& fn) const;
+
   // For each item in the LRU list, call fn(key, handle) in LRU order
   template <typename Fn>
   void for_each_lru(Fn&& fn) const;
@@ -86,12 +124,29 @@ class LRUCache {
   // return the existing one; if it is known for sure that the key must not
   // exist, set `hint_nonexist` to true to skip a lookup.
   Handle_t insert(Key_t key, bool pin = false, bool hint_nonexist = false);
-  // Search for a node; return nullptr if not exist. This op will refresh LRU.
+  // Same as `insert`, for an object of `size` bytes; if the key exists, its
+  // size is updated. Return nullptr if the object cannot fit, e.g., it is
+  // larger than the byte capacity or the rest of the cache is pinned; nothing
+  // is evicted then.
+  Handle_t insert_sized(Key_t key, uint32_t size, bool pin = false,
+                        bool hint_nonexist = false);
+  // Update the size of a node's object, evicting others to make room if it
+  // grows; return false and leave it (and the others) unchanged if it cannot
+  // fit.
+  bool resize(Handle_t handle, uint32_t size);
+  // Search for a node; return nullptr if not exist. This op will refresh LRU
+  // (or set the reference bit in CLOCK mode).
   Handle_t lookup(Key_t key, bool pin = false);
   // Release pinned node returned by insert/lookup.
   void release(Handle_t handle);
   // Pin a node returned by insert/lookup.
   void pin(Handle_t handle);
+  // Evict up to `n` objects ahead of time, in a batch as `relocate` does, so
+  // later inserts take free nodes instead of evicting; return the number
+  // evicted. E.g., a background thread calls it to keep some nodes free.
+  size_t reclaim(size_t n);
+  // Number of nodes in the free list
+  size_t num_free() const { return capacity_ - size_; }
 
   /**
    * The normal opeartions (`insert`/`lookup`/`release`) will only cause a node
@@ -119,7 +174,8 @@ class LRUCache {
   /****************************************************************************/
 
   // Init handle pool and table from externally instantiated ones but not owned
-  // them; the caller must free the pool and table after dtor.
+  // them; the caller must free the pool and table after dtor. `capacity` may
+  // be zero, in which case nodes are only added by `assign`.
   void init_from(Node_t* pool, NodeTable<Key_t, Value_t>* table,
                  size_t capacity);
 
@@ -132,6 +188,37 @@ class LRUCache {
   // `preempt`).
   void assign(Handle_t handle);
 
+  // Same as up to `n` calls to `preempt`, but in bulk: the free list is cut as
+  // one segment, and objects are evicted from the lru_ head as a batch, with
+  // their table removals prefetched ahead. The nodes are returned as a chain
+  // from `first` to `last` linked by next/prev (so only valid if the return
+  // value, the number of nodes, is non-zero).
+  size_t preempt_bulk(size_t n, Node_t*& first, Node_t*& last);
+
+  // Splice a chain returned by `preempt_bulk` into the free list in O(1)
+  // (duel with `preempt_bulk`).
+  void assign_bulk(Node_t* first, Node_t* last, size_t n);
+
+  // Give up to `bytes` of the byte capacity back to the caller, evicting
+  // objects to stay within what is left; return the number of bytes given up,
+  // which is less if pinned objects cannot be evicted.
+  size_t preempt_bytes(size_t bytes);
+
+  // Add `bytes` to the byte capacity (duel with `preempt_bytes`).
+  void assign_bytes(size_t bytes);
+
+  // Take a specific node, free or in the lru list, out of this LRUCache
+  // (dropping its key if any) so the caller can reuse it; fail if it is
+  // pinned. The node must not be erased. A key dropped counts as evicted if
+  // `is_eviction`.
+  bool retire(Node_t* e, bool is_eviction);
+
+  // Move a node holding a key from this LRUCache to `dst`, keeping it in the
+  // table, in exchange for one of dst's slots (a free one, or by evicting its
+  // least recently used object), so neither capacity changes; then look it up
+  // in `dst`. Fail if `dst` has no slot (or byte budget) to give.
+  bool migrate(Node_t* e, LRUCache& dst, bool pin);
+
   /****************************************************************************/
   /* Below are intrusive functions that should only be called by GhostCache   */
   /****************************************************************************/
@@ -143,7 +230,11 @@ class LRUCache {
 
  private:
   /* some internal implementation APIs (used by other classes in gcache) */
-  Node_t* insert_impl(Key_t key, uint32_t hash, bool pin, bool hint_nonexist);
+  Node_t* insert_impl(Key_t key, uint32_t hash, bool pin, bool hint_nonexist,
+                      uint32_t size = 0);
+  // Set the size of an existing node's object (looked up and pinned if asked
+  // by the caller already); if it cannot fit, undo the pin and return nullptr
+  Node_t* resize_impl(Node_t* e, uint32_t size, bool pin);
   Node_t* lookup_impl(Key_t key, uint32_t hash, bool pin);
   Node_t* install_impl(Key_t key);
   // Helper function for lookup: 1) pin the node if asked; 2) refresh LRU if in
@@ -151,7 +242,19 @@ class LRUCache {
   void lookup_refresh(Node_t* node, bool pin);
 
   Node_t* alloc_node();
+  // Evict up to `n` objects from the lru_ head as a batch, with their table
+  // removals prefetched ahead; return the number evicted, chained from
+  // `first` to `last` as in `preempt_bulk`.
+  size_t evict_bulk(size_t n, Node_t*& first, Node_t*& last);
+  // Append a chain to the free list
+  void free_chain(Node_t* first, Node_t* last);
   void free_node(Node_t* e);
+  // Remove the next victim from the LRU list and the table; return nullptr if
+  // the list is empty
+  Node_t* evict();
+  // Evict until `size` more bytes fit in the byte capacity; return false
+  // without evicting anything if they cannot, as too much is pinned
+  bool make_room(size_t size);
   void list_remove(Node_t* e);
   void list_append(Node_t* list, Node_t* e);
   void ref(Node_t* e);
@@ -166,11 +269,22 @@ class LRUCache {
   // Initialized before use.
   size_t capacity_;
 
+  // Total size of the objects in table_, and its bound
+  size_t bytes_;
+  size_t byte_capacity_;
+
+  // Counted by `evict` and `evict_bulk`, which every eviction to make room
+  // goes through, and by `retire`
+  uint64_t num_evicted_;
+
   // Manage batch of handle and place into the free list.
   // Allocate a handle from free_ and put it into table_; a handle in table_
   // must either present in lru_ or in_use_
   // If user calls `init_from`, this field will be nullptr
   Node_t* pool_;
+  // Number of handles in `pool_`; `capacity_` may drift from it due to
+  // `erase`/`install`
+  size_t pool_size_;
 
   // Hash table to lookup
   // If user calls `init_from`, this field will just refer to the external one;
@@ -199,10 +313,16 @@ class LRUCache {
   // Pool for additionaly allocated handles.
   std::vector<Node_t*> extra_pool_;
 
+  // Where `pool_` and `table_` are allocated from.
+  std::pmr::memory_resource* mr_;
+
   template <typename H, typename M>
   friend class GhostCache;
 
-  template <typename T, typename K, typename V, typename H>
+  template <uint32_t T, uint32_t Mi, uint32_t Ma, typename H, typename M>
+  friend class StaticGhostCache;
+
+  template <typename T, typename K, typename V, typename H, EvictMode M>
   friend class SharedCache;
 
  public:  // for debugging
@@ -212,9 +332,18 @@ class LRUCache {
   }
 };
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline LRUCache<Key_t, Value_t, Hash>::LRUCache()
-    : size_(0), capacity_(0), pool_(nullptr), table_(nullptr) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline LRUCache<Key_t, Value_t, Hash, Mode>::LRUCache(
+    std::pmr::memory_resource* mr)
+    : size_(0),
+      capacity_(0),
+      bytes_(0),
+      byte_capacity_(std::numeric_limits<size_t>::max()),
+      num_evicted_(0),
+      pool_(nullptr),
+      pool_size_(0),
+      table_(nullptr),
+      mr_(mr) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
@@ -225,8 +354,8 @@ inline LRUCache<Key_t, Value_t, Hash>::LRUCache()
   // free_ will be initialized when init() is called
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline LRUCache<Key_t, Value_t, Hash>::~LRUCache() {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline LRUCache<Key_t, Value_t, Hash, Mode>::~LRUCache() {
   /* Could be an error if caller has an unreleased node */
   // assert(in_use_.next == &in_use_);
 
@@ -239,20 +368,26 @@ inline LRUCache<Key_t, Value_t, Hash>::~LRUCache() {
     /* Unnecessary for correctness, but kept to ease debugging */
     // for (const Node_t* e = lru_.next; e != &lru_; e = e->next)
     //   assert(e->refs == 1);  // Invariant of lru_ list.
-    delete[] pool_;
-    delete table_;
+    std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+    std::destroy_n(pool_, pool_size_);
+    alloc.deallocate(pool_, pool_size_);
+    alloc.delete_object(table_);
   }
   /* `extrac_pool_` is always owned by this instance. */
   for (auto e : extra_pool_) delete e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::init(size_t capacity) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::init(size_t capacity) {
   assert(!capacity_ && !pool_ && !table_);
   assert(capacity);
   capacity_ = capacity;
-  pool_ = new Node_t[capacity];
+  std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+  pool_ = alloc.allocate(capacity);
+  pool_size_ = capacity;
+  std::uninitialized_default_construct_n(pool_, capacity);
   // Put these entries into free list
+  for (size_t i = 0; i < capacity; ++i) pool_[i].refs = 0;
   free_.next = &pool_[0];
   pool_[0].prev = &free_;
   free_.prev = &pool_[capacity - 1];
@@ -261,64 +396,101 @@ inline void LRUCache<Key_t, Value_t, Hash>::init(size_t capacity) {
     pool_[i].next = &pool_[i + 1];
     pool_[i + 1].prev = &pool_[i];
   }
-  table_ = new NodeTable<Key_t, Value_t>();
+  table_ = alloc.template new_object<NodeTable<Key_t, Value_t>>(mr_);
   table_->init(capacity);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::init(size_t capacity, Fn&& fn) {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::init(size_t capacity,
+                                                  Fn&& fn) {
   init(capacity);
   for (size_t i = 0; i < capacity; ++i) fn(&pool_[i]);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::init_bytes(
+    size_t capacity, size_t byte_capacity) {
+  static_assert(node_has_size<Value_t>,
+                "byte capacity needs nodes that carry a size");
+  init(capacity);
+  byte_capacity_ = byte_capacity;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each(Fn&& fn) const {
-  for_each_lru(fn);
-  for_each_in_use(fn);
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each(Fn&& fn) const {
+  // a sequential scan over the pool beats walking the lists unless most of
+  // the pool is free
+  if (pool_ && size_ * 4 >= pool_size_) {
+    for_each_pool(fn);
+  } else {
+    for_each_lru(fn);
+    for_each_in_use(fn);
+  }
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each_lru(Fn&& fn) const {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_pool(
+    Fn&& fn) const {
+  assert(pool_);
+  // a handle is in the lru or in-use list iff refs > 0
+  for (size_t i = 0; i < pool_size_; ++i)
+    if (pool_[i].refs) fn(&pool_[i]);
+  for (auto e : extra_pool_)
+    if (e->refs) fn(e);
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+template <typename Fn>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_lru(Fn&& fn) const {
   for (auto h = lru_.next; h != &lru_; h = h->next) fn(h);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each_mru(Fn&& fn) const {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_mru(Fn&& fn) const {
   for (auto h = lru_.prev; h != &lru_; h = h->prev) fn(h);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each_in_use(Fn&& fn) const {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_in_use(
+    Fn&& fn) const {
   for (auto h = in_use_.next; h != &in_use_; h = h->next) fn(h);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each_until_lru(Fn&& fn) const {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_until_lru(
+    Fn&& fn) const {
   for (auto h = lru_.next; h != &lru_; h = h->next) {
     if (!fn(h)) break;
   }
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
 template <typename Fn>
-inline void LRUCache<Key_t, Value_t, Hash>::for_each_until_mru(Fn&& fn) const {
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::for_each_until_mru(
+    Fn&& fn) const {
   for (auto h = lru_.prev; h != &lru_; h = h->prev)
     if (!fn(h)) break;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::init_from(
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::init_from(
     Node_t* pool, NodeTable<Key_t, Value_t>* table, size_t capacity) {
   assert(!capacity_ && !pool_ && !table_);
-  assert(capacity);
+  table_ = table;
+  if (!capacity) {
+    free_.next = &free_;
+    free_.prev = &free_;
+    return;
+  }
   capacity_ = capacity;
   // same as `init` but directly use `pool` instead of `pool_`
+  for (size_t i = 0; i < capacity; ++i) pool[i].refs = 0;
   free_.next = &pool[0];
   pool[0].prev = &free_;
   free_.prev = &pool[capacity - 1];
@@ -327,20 +499,20 @@ inline void LRUCache<Key_t, Value_t, Hash>::init_from(
     pool[i].next = &pool[i + 1];
     pool[i + 1].prev = &pool[i];
   }
-  table_ = table;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Handle_t
-LRUCache<Key_t, Value_t, Hash>::insert(Key_t key, bool pin,
-                                       bool hint_nonexist) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::insert(Key_t key, bool pin,
+                                             bool hint_nonexist) {
   return insert_impl(key, Hash{}(key), pin, hint_nonexist);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Node_t*
-LRUCache<Key_t, Value_t, Hash>::insert_impl(Key_t key, uint32_t hash, bool pin,
-                                            bool hint_nonexist) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::insert_impl(Key_t key, uint32_t hash,
+                                                  bool pin, bool hint_nonexist,
+                                                  uint32_t size) {
   // Disable support for capacity_ == 0; the user must set capacity first
   assert(capacity_ > 0);
 
@@ -353,9 +525,12 @@ LRUCache<Key_t, Value_t, Hash>::insert_impl(Key_t key, uint32_t hash, bool pin,
     assert(!table_->lookup(key, hash));  // check if hint is correct
   }
 
+  // an object larger than the byte capacity would evict everything first
+  if (size > byte_capacity_ || !make_room(size)) return nullptr;
   e = alloc_node();
   if (!e) return nullptr;
   e->init(key, hash);
+  e->set_size(size);
   table_->insert(e);
   assert(e->refs == 1);
   if (pin) {
@@ -365,26 +540,69 @@ LRUCache<Key_t, Value_t, Hash>::insert_impl(Key_t key, uint32_t hash, bool pin,
     list_append(&lru_, e);
   }
   ++size_;
+  bytes_ += size;
+  return e;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::insert_sized(Key_t key, uint32_t size,
+                                                   bool pin,
+                                                   bool hint_nonexist) {
+  uint32_t hash = Hash{}(key);
+  if (!hint_nonexist) {
+    Node_t* e = lookup_impl(key, hash, pin);
+    if (e) return resize_impl(e, size, pin);
+  }
+  return insert_impl(key, hash, pin, /*hint_nonexist*/ true, size);
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline bool LRUCache<Key_t, Value_t, Hash, Mode>::resize(Handle_t handle,
+                                                         uint32_t size) {
+  return resize_impl(handle.node, size, /*pin*/ false);
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::resize_impl(Node_t* e, uint32_t size,
+                                                  bool pin) {
+  if (size > e->get_size()) {
+    // pin it while making room so that it is not evicted itself
+    bool fits = size <= byte_capacity_;
+    if (fits) {
+      ref(e);
+      fits = make_room(size - e->get_size());
+      unref(e);
+    }
+    if (!fits) {
+      if (pin) unref(e);
+      return nullptr;
+    }
+  }
+  bytes_ += size;
+  bytes_ -= e->get_size();
+  e->set_size(size);
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Handle_t
-LRUCache<Key_t, Value_t, Hash>::lookup(Key_t key, bool pin) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::lookup(Key_t key, bool pin) {
   return lookup_impl(key, Hash{}(key), pin);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Node_t*
-LRUCache<Key_t, Value_t, Hash>::lookup_impl(Key_t key, uint32_t hash,
-                                            bool pin) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::lookup_impl(Key_t key, uint32_t hash,
+                                                  bool pin) {
   Node_t* e = table_->lookup(key, hash);
   if (e) lookup_refresh(e, pin);
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::release(Handle_t handle) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::release(Handle_t handle) {
   // release can only called if the caller has previously pinned the handle;
   // the handle thus must still have nonzero refs
   Node_t* e = handle.node;
@@ -393,14 +611,14 @@ inline void LRUCache<Key_t, Value_t, Hash>::release(Handle_t handle) {
   assert(e->refs > 0);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::pin(Handle_t handle) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::pin(Handle_t handle) {
   ref(handle.node);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Handle_t
-LRUCache<Key_t, Value_t, Hash>::preempt() {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::preempt() {
   // In fact, it is just like allocate a handle but instead of using it
   // immediately, return it out to caller (i.e. SharedCache).
   // We keep this function independent from `alloc_node` to make it
@@ -410,25 +628,141 @@ LRUCache<Key_t, Value_t, Hash>::preempt() {
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::assign(Handle_t e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::assign(Handle_t e) {
   ++capacity_;
   free_node(e.node);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::lookup_refresh(Node_t* node,
-                                                           bool pin) {
-  if (pin)
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline size_t LRUCache<Key_t, Value_t, Hash, Mode>::preempt_bulk(
+    size_t n, Node_t*& first, Node_t*& last) {
+  size_t num_taken = 0;
+  // take the free nodes first; the whole free list is cut in O(1)
+  size_t num_free = std::min(n, capacity_ - size_);
+  if (num_free) {
+    first = free_.next;
+    if (num_free == capacity_ - size_) {
+      last = free_.prev;
+    } else {
+      last = first;
+      for (size_t i = 1; i < num_free; ++i) last = last->next;
+    }
+    first->prev->next = last->next;
+    last->next->prev = first->prev;
+    num_taken = num_free;
+  }
+
+  Node_t* evicted_first;
+  Node_t* evicted_last;
+  size_t num_evicted = evict_bulk(n - num_taken, evicted_first, evicted_last);
+  if (num_evicted) {
+    if (num_taken) {
+      last->next = evicted_first;
+      evicted_first->prev = last;
+    } else {
+      first = evicted_first;
+    }
+    last = evicted_last;
+    num_taken += num_evicted;
+  }
+  capacity_ -= num_taken;
+  return num_taken;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::assign_bulk(Node_t* first,
+                                                              Node_t* last,
+                                                              size_t n) {
+  free_chain(first, last);
+  capacity_ += n;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline size_t LRUCache<Key_t, Value_t, Hash, Mode>::reclaim(size_t n) {
+  Node_t* first;
+  Node_t* last;
+  size_t num_evicted = evict_bulk(n, first, last);
+  if (num_evicted) free_chain(first, last);
+  return num_evicted;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline size_t LRUCache<Key_t, Value_t, Hash, Mode>::preempt_bytes(
+    size_t bytes) {
+  size_t target = byte_capacity_ - std::min(bytes, byte_capacity_);
+  while (bytes_ > target) {
+    Node_t* e = evict();
+    if (!e) break;
+    free_node(e);
+  }
+  size_t n = byte_capacity_ - std::max(target, bytes_);
+  byte_capacity_ -= n;
+  return n;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::assign_bytes(size_t bytes) {
+  byte_capacity_ += bytes;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline bool LRUCache<Key_t, Value_t, Hash, Mode>::retire(Node_t* e,
+                                                         bool is_eviction) {
+  if (e->refs > 1) return false;
+  list_remove(e);  // from lru_ if refs == 1, or else free_
+  if (e->refs == 1) {
+    [[maybe_unused]] Node_t* e_;
+    e_ = table_->remove(e->key, e->hash);
+    assert(e_ == e);
+    --size_;
+    bytes_ -= e->get_size();
+    num_evicted_ += is_eviction;
+  }
+  e->refs = 0;
+  --capacity_;
+  return true;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline bool LRUCache<Key_t, Value_t, Hash, Mode>::migrate(Node_t* e,
+                                                          LRUCache& dst,
+                                                          bool pin) {
+  assert(e->refs > 0);
+  if (!dst.make_room(e->get_size())) return false;
+  Node_t* slot = dst.alloc_node();
+  if (!slot) return false;
+  free_node(slot);
+  list_remove(e);  // from lru_ or in_use_
+  --size_;
+  bytes_ -= e->get_size();
+  dst.list_append(e->refs == 1 ? &dst.lru_ : &dst.in_use_, e);
+  ++dst.size_;
+  dst.bytes_ += e->get_size();
+  dst.lookup_refresh(e, pin);
+  return true;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::lookup_refresh(
+    Node_t* node, bool pin) {
+  if (pin) {
     ref(node);
-  else if (node->refs == 1)
-    lru_refresh(node);
+  } else if (node->refs == 1) {
+    if constexpr (Mode == EvictMode::CLOCK) {
+      // skip the store if already set, so a hot node's line stays clean
+      if (!node->referenced) node->referenced = 1;
+    } else {
+      lru_refresh(node);
+    }
+  }
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Handle_t
-LRUCache<Key_t, Value_t, Hash>::refresh(Key_t key, uint32_t hash,
-                                        Handle_t& successor) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::refresh(Key_t key, uint32_t hash,
+                                              Handle_t& successor) {
+  static_assert(Mode == EvictMode::LRU, "GhostCache needs the exact LRU order");
   // Disable support for capacity_ == 0; the user must set capacity first
   assert(capacity_ > 0);
 
@@ -450,8 +784,8 @@ LRUCache<Key_t, Value_t, Hash>::refresh(Key_t key, uint32_t hash,
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline bool LRUCache<Key_t, Value_t, Hash>::erase(Handle_t handle) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline bool LRUCache<Key_t, Value_t, Hash, Mode>::erase(Handle_t handle) {
   Node_t* e = handle.node;
   assert(e);
   if (e->refs != 1) return false;
@@ -465,18 +799,19 @@ inline bool LRUCache<Key_t, Value_t, Hash>::erase(Handle_t handle) {
   assert(e_ == e);
   --size_;
   --capacity_;
+  bytes_ -= e->get_size();
   return true;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Handle_t
-LRUCache<Key_t, Value_t, Hash>::install(Key_t key) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Handle_t
+LRUCache<Key_t, Value_t, Hash, Mode>::install(Key_t key) {
   return install_impl(key);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Node_t*
-LRUCache<Key_t, Value_t, Hash>::install_impl(Key_t key) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::install_impl(Key_t key) {
   Node_t* e;
   if (erased_.next == &erased_) {
     e = new Node_t;  // caller is responsible for setting the value
@@ -493,9 +828,9 @@ LRUCache<Key_t, Value_t, Hash>::install_impl(Key_t key) {
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Node_t*
-LRUCache<Key_t, Value_t, Hash>::alloc_node() {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::alloc_node() {
   if (free_.next != &free_) {  // Allocate from free list
     Node_t* e = free_.next;
     list_remove(e);
@@ -503,24 +838,122 @@ LRUCache<Key_t, Value_t, Hash>::alloc_node() {
   }
 
   // Evict one handle from LRU and recycle it
+  return evict();
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::evict() {
   if (lru_.next == &lru_) return nullptr;  // No more space
   Node_t* e = lru_.next;
+  if constexpr (Mode == EvictMode::CLOCK) {
+    // second chance; terminates as each pass clears a bit
+    while (e->referenced) {
+      e->referenced = 0;
+      list_remove(e);
+      list_append(&lru_, e);
+      e = lru_.next;
+    }
+  }
   assert(e->refs == 1);
   list_remove(e);  // Remove from lru_
   [[maybe_unused]] Node_t* e_;
   e_ = table_->remove(e->key, e->hash);
   assert(e_ == e);
   --size_;
+  bytes_ -= e->get_size();
+  ++num_evicted_;
   return e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::free_node(Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline bool LRUCache<Key_t, Value_t, Hash, Mode>::make_room(size_t size) {
+  if (bytes_ + size <= byte_capacity_) return true;
+  // Check that the unpinned objects add up to enough before evicting any.
+  // The walk stops as soon as they do, so in LRU mode it visits the same
+  // objects that are then evicted; only a request that fails walks the whole
+  // list.
+  size_t need = bytes_ + size - byte_capacity_;
+  size_t evictable = 0;
+  for (Node_t* e = lru_.next; evictable < need; e = e->next) {
+    if (e == &lru_) return false;
+    evictable += e->get_size();
+  }
+  while (bytes_ + size > byte_capacity_) {
+    Node_t* e = evict();
+    if (!e) return false;
+    free_node(e);
+  }
+  return true;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline size_t LRUCache<Key_t, Value_t, Hash, Mode>::evict_bulk(
+    size_t n, Node_t*& first, Node_t*& last) {
+  // the victims stay in a row at the head, as CLOCK moves referenced nodes to
+  // the tail, so they are cut as one segment
+  constexpr int kPrefetchDistance = 8;
+  Node_t* victim = &lru_;  // the last one
+  Node_t* ahead = lru_.next;
+  for (int i = 0; i < kPrefetchDistance && ahead != &lru_; ++i) {
+    table_->prefetch(ahead->hash);
+    ahead = ahead->next;
+  }
+  size_t num_evicted = 0;
+  for (Node_t* e = lru_.next; num_evicted < n && e != &lru_;) {
+    if (ahead != &lru_) {
+      table_->prefetch(ahead->hash);
+      ahead = ahead->next;
+    }
+    if constexpr (Mode == EvictMode::CLOCK) {
+      if (e->referenced) {  // second chance, as in `evict`
+        e->referenced = 0;
+        Node_t* next = e->next;
+        list_remove(e);
+        list_append(&lru_, e);
+        // if it was the tail, it is the next to visit again
+        e = next == &lru_ ? e : next;
+        continue;
+      }
+    }
+    assert(e->refs == 1);
+    [[maybe_unused]] Node_t* e_;
+    e_ = table_->remove(e->key, e->hash);
+    assert(e_ == e);
+    e->refs = 0;
+    bytes_ -= e->get_size();
+    victim = e;
+    ++num_evicted;
+    e = e->next;
+  }
+  if (num_evicted) {
+    first = lru_.next;
+    last = victim;
+    lru_.next = victim->next;
+    victim->next->prev = &lru_;
+    size_ -= num_evicted;
+    num_evicted_ += num_evicted;
+  }
+  return num_evicted;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::free_chain(Node_t* first,
+                                                             Node_t* last) {
+  first->prev = free_.prev;
+  last->next = &free_;
+  free_.prev->next = first;
+  free_.prev = last;
+}
+
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::free_node(Node_t* e) {
+  e->refs = 0;  // may come from another cache's lru list via `preempt`
   list_append(&free_, e);
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::ref(Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::ref(Node_t* e) {
   if (e->refs == 1) {  // If on lru_ list, move to in_use_ list.
     list_remove(e);
     list_append(&in_use_, e);
@@ -528,8 +961,8 @@ inline void LRUCache<Key_t, Value_t, Hash>::ref(Node_t* e) {
   e->refs++;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::unref(Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::unref(Node_t* e) {
   assert(e->refs > 0);
   e->refs--;
   if (e->refs == 0) {  // Deallocate.
@@ -541,15 +974,15 @@ inline void LRUCache<Key_t, Value_t, Hash>::unref(Node_t* e) {
   }
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::list_remove(Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::list_remove(Node_t* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline void LRUCache<Key_t, Value_t, Hash>::list_append(Node_t* list,
-                                                        Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline void LRUCache<Key_t, Value_t, Hash, Mode>::list_append(Node_t* list,
+                                                              Node_t* e) {
   // Make "e" newest entry by inserting just before *list
   e->next = list;
   e->prev = list->prev;
@@ -557,9 +990,9 @@ inline void LRUCache<Key_t, Value_t, Hash>::list_append(Node_t* list,
   e->next->prev = e;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline typename LRUCache<Key_t, Value_t, Hash>::Node_t*
-LRUCache<Key_t, Value_t, Hash>::lru_refresh(Node_t* e) {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline typename LRUCache<Key_t, Value_t, Hash, Mode>::Node_t*
+LRUCache<Key_t, Value_t, Hash, Mode>::lru_refresh(Node_t* e) {
   assert(e != &lru_);
   assert(e->refs == 1);
   auto successor = e->next;
@@ -569,9 +1002,9 @@ LRUCache<Key_t, Value_t, Hash>::lru_refresh(Node_t* e) {
   return successor;
 }
 
-template <typename Key_t, typename Value_t, typename Hash>
-inline std::ostream& LRUCache<Key_t, Value_t, Hash>::print(std::ostream& os,
-                                                           int indent) const {
+template <typename Key_t, typename Value_t, typename Hash, EvictMode Mode>
+inline std::ostream& LRUCache<Key_t, Value_t, Hash, Mode>::print(
+    std::ostream& os, int indent) const {
   os << "LRUCache (capacity=" << capacity_ << ") {\n";
   for (int i = 0; i < indent + 1; ++i) os << '\t';
   os << "lru:    [";
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "policy_kv_cache.h"
+#include "stat.h"
+
+namespace gcache {
+
+// Keys the smallest mini cache of a MiniSimKvCache must hold
+inline constexpr uint32_t kMiniSimMinCount = 32;
+
+// The largest sample shift, up to `limit`, that scales a grid of cache sizes
+// down exactly and leaves the smallest mini cache kMiniSimMinCount keys or
+// more; 0 (a full simulation) if the grid starts below that
+constexpr uint32_t mini_sim_sample_shift(uint32_t tick, uint32_t min_count,
+                                         uint32_t max_count,
+                                         uint32_t limit = 31) {
+  uint32_t shift = limit;
+  while (shift > 0 && ((min_count >> shift) < kMiniSimMinCount ||
+                       (tick | min_count | max_count) & ((1u << shift) - 1)))
+    --shift;
+  return shift;
+}
+
+/**
+ * Estimate the miss rate curve of an eviction policy without the stack
+ * property (one of the simulators in policy_cache.h) by miniature simulation:
+ * only keys whose hash has SampleShift leading zeros are simulated, i.e.,
+ * 1 in 2^SampleShift of them, against caches 2^SampleShift times smaller than
+ * the sizes of the curve. Sampling is the same as in SampledGhostKvCache, and
+ * so are the constructor arguments and the curve, so it can be used in place
+ * of it.
+ *
+ * Tiny mini caches are inaccurate (about 5 points of miss rate when the
+ * smallest holds 4 keys), so the smallest must hold kMiniSimMinCount keys
+ * or more, i.e., min_count must be at least kMiniSimMinCount << SampleShift;
+ * `mini_sim_sample_shift` picks the shift for a grid, and the default fits
+ * the 64..1024 grid mtcache uses. The saving is well short of 2^SampleShift:
+ * replaying 1.5M requests against LRU, S3-FIFO and ARC, peak memory was about
+ * 2/3 and run time about 3/5 of PolicyKvCache's at 1/2 (0.5-0.7 points of
+ * mean error), and 2/5 in both at 1/4 on a grid twice as large (1.4-1.8).
+ */
+template <typename Policy, uint32_t SampleShift = 1,
+          typename Hash = std::hash<std::string_view>>
+class MiniSimKvCache {
+  PolicyKvCache<Policy, Hash> mini_caches;
+
+ public:
+  MiniSimKvCache(
+      uint32_t tick, uint32_t min_count, uint32_t max_count,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : mini_caches(tick >> SampleShift, min_count >> SampleShift,
+                    max_count >> SampleShift, mr) {
+    static_assert(SampleShift < 32, "SampleShift must be smaller than 32");
+    assert(min_count >> SampleShift >= kMiniSimMinCount || SampleShift == 0);
+    assert(tick % (1 << SampleShift) == 0);
+    assert(min_count % (1 << SampleShift) == 0);
+    assert(max_count % (1 << SampleShift) == 0);
+  }
+
+  void access(const std::string_view key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    uint32_t key_hash = Hash{}(key);
+    access(key_hash, kv_size, mode);
+  }
+
+  void access(uint32_t key_hash, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    // only with certain number of leading zeros is sampled
+    if constexpr (SampleShift > 0) {
+      if (key_hash >> (32 - SampleShift)) return;
+    }
+    mini_caches.access(key_hash, kv_size, mode);
+  }
+
+  // Bounds are scaled back to unsampled keys
+  [[nodiscard]] uint32_t get_tick() const {
+    return mini_caches.get_tick() << SampleShift;
+  }
+  [[nodiscard]] uint32_t get_min_count() const {
+    return mini_caches.get_min_count() << SampleShift;
+  }
+  [[nodiscard]] uint32_t get_max_count() const {
+    return mini_caches.get_max_count() << SampleShift;
+  }
+  [[nodiscard]] double get_hit_rate(uint32_t count) {
+    return get_stat(count).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t count) {
+    return get_stat(count).get_miss_rate();
+  }
+  // Stats are of the sampled accesses only
+  [[nodiscard]] const CacheStat& get_stat(uint32_t count) {
+    return mini_caches.get_stat(count >> SampleShift);
+  }
+
+  void reset_stat() { mini_caches.reset_stat(); }
+
+  // Counts and sizes of the mini caches scaled back up by 2^SampleShift
+  [[nodiscard]] const std::vector<std::tuple<
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve() const {
+    auto curve = mini_caches.get_cache_stat_curve();
+    for (auto& [count, size, stat] : curve) {
+      count <<= SampleShift;
+      size <<= SampleShift;
+    }
+    return curve;
+  }
+};
+}  // namespace gcache
@@ -30,29 +30,99 @@ namespace gcache {
 template <typename Key_t, typename Value_t>
 class NodeTable;
 
-template <typename Key_t, typename Value_t, typename Hash>
+// How an LRUCache picks the node to evict
+enum class EvictMode {
+  // a hit moves the node to the newest end of the LRU list
+  LRU,
+  // a hit only sets the node's reference bit; eviction takes the oldest node
+  // whose bit is clear, giving each referenced one a second chance instead
+  CLOCK,
+};
+
+template <typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode = EvictMode::LRU>
 class LRUCache;
 
 template <typename Hash, typename Meta>
 class GhostCache;
 
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode = EvictMode::LRU>
+class SharedCache;
+
+template <typename Tag_t, typename Key_t, typename Value_t>
+class TaggedHandle;
+
+template <uint32_t Tick, uint32_t MinSize, uint32_t MaxSize, typename Hash,
+          typename Meta>
+class StaticGhostCache;
+
+class PolicyCacheBase;
+
+// Whether the nodes of a value type carry the size of their object, which
+// only an LRUCache in byte-capacity mode counts. The metadata types of the
+// engines that never use it (GhostCache, the policy simulators) turn it off,
+// so that their nodes do not grow by it.
+template <typename Value_t>
+inline constexpr bool node_has_size = true;
+
+template <bool HasSize>
+struct NodeSize {
+  uint32_t value;
+};
+template <>
+struct NodeSize<false> {};
+
 // LRUNodes forms a circular doubly linked list ordered by access time.
 template <typename Key_t, typename Value_t>
 class LRUNode {
   LRUNode *next_hash;
   LRUNode *next;
   LRUNode *prev;
-  uint32_t refs;  // References, including cache reference, if present.
+  // References, including cache reference, if present.
+  uint32_t refs : 31;
+  // Reference bit of EvictMode::CLOCK; shares a word with refs so that the
+  // node does not grow
+  uint32_t referenced : 1;
+  // Size of the object in bytes; only counted against a byte capacity, and
+  // takes no space unless node_has_size<Value_t>
+  [[no_unique_address]] NodeSize<node_has_size<Value_t>> size;
 
  protected:
   friend class NodeTable<Key_t, Value_t>;
 
-  template <typename K, typename V, typename H>
+  template <typename K, typename V, typename H, EvictMode M>
   friend class LRUCache;
 
   template <typename H, typename M>
   friend class GhostCache;
 
+  template <uint32_t T, uint32_t Mi, uint32_t Ma, typename H, typename M>
+  friend class StaticGhostCache;
+
+  template <typename T, typename K, typename V, typename H, EvictMode M>
+  friend class SharedCache;
+
+  template <typename T, typename K, typename V>
+  friend class TaggedHandle;
+
+  friend class PolicyCacheBase;
+
+  uint32_t get_size() const {
+    if constexpr (node_has_size<Value_t>) {
+      return size.value;
+    } else {
+      return 0;
+    }
+  }
+  void set_size(uint32_t s) {
+    if constexpr (node_has_size<Value_t>) {
+      size.value = s;
+    } else {
+      assert(s == 0);
+    }
+  }
+
  public:
   uint32_t hash;  // Hash of key; used for fast sharding and comparisons
   Key_t key;
@@ -60,6 +130,8 @@ class LRUNode {
 
   void init(Key_t k, uint32_t h) {
     this->refs = 1;
+    this->referenced = 0;
+    this->set_size(0);
     this->hash = h;
     this->key = k;
   }
@@ -137,12 +209,18 @@ class LRUHandle : public BaseHandle<LRUNode<Key_t, Value_t>> {
  protected:
   friend class NodeTable<Key_t, Value_t>;
 
-  template <typename K, typename V, typename H>
+  template <typename K, typename V, typename H, EvictMode M>
   friend class LRUCache;
 
   template <typename H, typename M>
   friend class GhostCache;
 
+  template <uint32_t T, uint32_t Mi, uint32_t Ma, typename H, typename M>
+  friend class StaticGhostCache;
+
+  template <typename T, typename K, typename V, typename H, EvictMode M>
+  friend class SharedCache;
+
  public:
   LRUHandle(Node_t *node) : BaseHandle<Node_t>(node) {}
   LRUHandle() = default;
@@ -158,6 +236,7 @@ class LRUHandle : public BaseHandle<LRUNode<Key_t, Value_t>> {
   const Value_t &operator*() const { return &node->value; }
 
   Key_t get_key() const { return node->key; }
+  uint32_t get_size() const { return node->get_size(); }
 };
 
 static_assert(sizeof(LRUHandle<int, int>) == 8);
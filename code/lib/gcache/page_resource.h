@@ -0,0 +1,121 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+namespace gcache {
+
+enum class PageMode {
+  NORMAL,       // regular 4K pages
+  TRANSPARENT,  // 2M transparent huge pages via madvise(MADV_HUGEPAGE)
+  HUGETLB,      // explicit 2M pages from hugetlbfs (MAP_HUGETLB)
+};
+
+/**
+ * A memory resource that maps every large allocation (e.g., an LRUCache handle
+ * pool or its hash table buckets) directly with mmap, so the page size and
+ * NUMA placement of the allocation can be chosen:
+ * - `mode` selects regular pages, transparent huge pages or hugetlbfs pages;
+ *   HUGETLB falls back to TRANSPARENT if no huge pages are reserved
+ *   (see /proc/sys/vm/nr_hugepages), which is counted by `num_fallbacks()`.
+ * - `numa_node` binds the mapping to that node with mbind before it is first
+ *   touched; -1 leaves placement to the default (first-touch) policy.
+ *
+ * Allocations smaller than a page are forwarded to `upstream`, since giving
+ * each of them a whole mapping would waste most of it.
+ */
+class PageResource : public std::pmr::memory_resource {
+  static constexpr size_t page_size = 4 << 10;
+  static constexpr size_t huge_page_size = 2 << 20;
+
+  // from <numaif.h>; defined here to avoid a dependency on libnuma
+  static constexpr int mpol_bind = 2;
+  static constexpr unsigned mpol_mf_strict = 1;
+
+  const PageMode mode_;
+  const int numa_node_;
+  std::pmr::memory_resource* const upstream_;
+  size_t mapped_;
+  size_t num_fallbacks_;
+
+  [[nodiscard]] size_t map_size(size_t bytes) const {
+    size_t align = mode_ == PageMode::NORMAL ? page_size : huge_page_size;
+    return (bytes + align - 1) / align * align;
+  }
+
+  void bind(void* p, size_t size) const {
+    if (numa_node_ < 0) return;
+    constexpr size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(numa_node_ / bits + 1, 0);
+    mask.back() |= 1UL << (numa_node_ % bits);
+    // the kernel expects maxnode to be one more than the number of bits
+    if (syscall(SYS_mbind, p, size, mpol_bind, mask.data(),
+                mask.size() * bits + 1, mpol_mf_strict) != 0) {
+      munmap(p, size);
+      throw std::bad_alloc();
+    }
+  }
+
+ public:
+  explicit PageResource(
+      PageMode mode = PageMode::TRANSPARENT, int numa_node = -1,
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : mode_(mode),
+        numa_node_(numa_node),
+        upstream_(upstream),
+        mapped_(0),
+        num_fallbacks_(0) {}
+  PageResource(const PageResource&) = delete;
+  PageResource& operator=(const PageResource&) = delete;
+
+  [[nodiscard]] PageMode mode() const { return mode_; }
+  [[nodiscard]] int numa_node() const { return numa_node_; }
+  // Bytes currently mapped by this resource (excluding upstream)
+  [[nodiscard]] size_t mapped() const { return mapped_; }
+  // Number of HUGETLB allocations served with transparent huge pages instead
+  [[nodiscard]] size_t num_fallbacks() const { return num_fallbacks_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    if (bytes < page_size || alignment > page_size)
+      return upstream_->allocate(bytes, alignment);
+    size_t size = map_size(bytes);
+    void* p = MAP_FAILED;
+    if (mode_ == PageMode::HUGETLB) {
+      p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p == MAP_FAILED) ++num_fallbacks_;
+    }
+    if (p == MAP_FAILED) {
+      p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) throw std::bad_alloc();
+      if (mode_ != PageMode::NORMAL) madvise(p, size, MADV_HUGEPAGE);
+    }
+    bind(p, size);
+    mapped_ += size;
+    return p;
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    if (bytes < page_size || alignment > page_size)
+      return upstream_->deallocate(p, bytes, alignment);
+    size_t size = map_size(bytes);
+    munmap(p, size);
+    mapped_ -= size;
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+}  // namespace gcache
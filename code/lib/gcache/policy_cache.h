@@ -0,0 +1,648 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+
+#include "ghost_cache.h"
+#include "node.h"
+#include "stat.h"
+#include "table.h"
+
+namespace gcache {
+
+// Per-key state of the policy simulators
+struct PolicyMeta {
+  uint32_t kv_size;
+  uint32_t freq;  // reference bit or access count, depending on the policy
+  uint8_t queue;  // which of the policy's lists the key is in
+};
+template <>
+inline constexpr bool node_has_size<PolicyMeta> = false;
+
+/**
+ * Base of the eviction policy simulators below. Unlike GhostCache, which gets
+ * the stats of every LRU cache size at once from the stack property, each of
+ * these simulates one cache of a fixed capacity, since FIFO, CLOCK, and the
+ * rest are not stack algorithms.
+ *
+ * A simulator owns a pool of `capacity` nodes for resident keys plus the
+ * nodes of keys remembered after eviction ("ghosts"), all indexed by one
+ * NodeTable; each policy links them into its own lists. Keys are expected to
+ * be hashes already (as in SampledGhostKvCache), so they index the table
+ * directly.
+ */
+class PolicyCacheBase {
+ public:
+  using Node_t = LRUNode<uint32_t, PolicyMeta>;
+
+  PolicyCacheBase(const PolicyCacheBase&) = delete;
+  PolicyCacheBase(PolicyCacheBase&&) = delete;
+  PolicyCacheBase& operator=(const PolicyCacheBase&) = delete;
+  PolicyCacheBase& operator=(PolicyCacheBase&&) = delete;
+
+  [[nodiscard]] size_t capacity() const { return capacity_; }
+  // Number of resident keys
+  [[nodiscard]] size_t size() const { return size_; }
+  // Total kv size of resident keys
+  [[nodiscard]] uint64_t size_bytes() const { return bytes_; }
+  [[nodiscard]] const CacheStat& get_stat() const { return stat_; }
+  void reset_stat() { stat_.reset(); }
+
+ protected:
+  // The pool and table are allocated from `mr`, which must outlive the cache
+  PolicyCacheBase(size_t capacity, size_t num_ghosts,
+                  std::pmr::memory_resource* mr)
+      : pool_size_(capacity + num_ghosts),
+        table_(mr),
+        mr_(mr),
+        capacity_(capacity),
+        size_(0),
+        bytes_(0) {
+    assert(capacity > 0);
+    std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+    pool_ = alloc.allocate(pool_size_);
+    std::uninitialized_default_construct_n(pool_, pool_size_);
+    list_init(&free_);
+    for (size_t i = 0; i < pool_size_; ++i) list_append(&free_, &pool_[i]);
+    table_.init(pool_size_);
+  }
+  ~PolicyCacheBase() {
+    std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+    std::destroy_n(pool_, pool_size_);
+    alloc.deallocate(pool_, pool_size_);
+  }
+
+  // A list is a dummy head; head.next is the oldest and head.prev the newest
+  static void list_init(Node_t* head) { head->next = head->prev = head; }
+  static bool list_empty(const Node_t* head) { return head->next == head; }
+  static Node_t* list_oldest(Node_t* head) { return head->next; }
+  static Node_t* newer(Node_t* e) { return e->next; }
+  static Node_t* older(Node_t* e) { return e->prev; }
+  static void list_remove(Node_t* e) {
+    e->next->prev = e->prev;
+    e->prev->next = e->next;
+  }
+  static void list_insert_after(Node_t* pos, Node_t* e) {
+    e->prev = pos;
+    e->next = pos->next;
+    e->next->prev = e;
+    pos->next = e;
+  }
+  static void list_append(Node_t* head, Node_t* e) {
+    list_insert_after(head->prev, e);
+  }
+  static void list_move(Node_t* head, Node_t* e) {
+    list_remove(e);
+    list_append(head, e);
+  }
+
+  Node_t* lookup(uint32_t key) { return table_.lookup(key, key); }
+
+  // Take a free node for `key`, which must not be present, as a resident key;
+  // the caller links it into a list
+  Node_t* insert(uint32_t key, uint32_t kv_size, uint8_t queue) {
+    assert(!list_empty(&free_));
+    Node_t* e = list_oldest(&free_);
+    list_remove(e);
+    e->init(key, key);
+    e->value.freq = 0;
+    e->value.queue = queue;
+    table_.insert(e);
+    admit(e, kv_size);
+    return e;
+  }
+
+  // Unlink a key from its list and return its node to the pool
+  void remove(Node_t* e) {
+    list_remove(e);
+    [[maybe_unused]] Node_t* e_ = table_.remove(e->key, e->hash);
+    assert(e_ == e);
+    list_append(&free_, e);
+  }
+
+  // Account a key as resident or not; a ghost keeps its node but no size
+  void admit(Node_t* e, uint32_t kv_size) {
+    e->value.kv_size = kv_size;
+    ++size_;
+    bytes_ += kv_size;
+  }
+  void demote(Node_t* e) {
+    --size_;
+    bytes_ -= e->value.kv_size;
+  }
+  void evict(Node_t* e) {
+    demote(e);
+    remove(e);
+  }
+
+  // A hit may carry a new size of the value
+  void resize(Node_t* e, uint32_t kv_size) {
+    bytes_ += kv_size;
+    bytes_ -= e->value.kv_size;
+    e->value.kv_size = kv_size;
+  }
+
+  // Count an access as `mode` says; NOOP only updates the policy's state
+  bool record(bool hit, AccessMode mode) {
+    switch (mode) {
+      case AccessMode::DEFAULT:
+        hit ? stat_.add_hit() : stat_.add_miss();
+        break;
+      case AccessMode::AS_MISS:
+        stat_.add_miss();
+        break;
+      case AccessMode::AS_HIT:
+        stat_.add_hit();
+        break;
+      case AccessMode::NOOP:
+        break;
+    }
+    return hit;
+  }
+
+ private:
+  Node_t* pool_;
+  size_t pool_size_;
+  NodeTable<uint32_t, PolicyMeta> table_;
+  Node_t free_;
+  std::pmr::memory_resource* mr_;
+
+ protected:
+  const size_t capacity_;
+  size_t size_;
+  uint64_t bytes_;
+  CacheStat stat_;
+};
+
+// Evict the least recently used key; the same as GhostCache at one size, as a
+// baseline for the others at equal cost
+class LruCache : public PolicyCacheBase {
+  Node_t queue_;
+
+ public:
+  explicit LruCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, 0, mr) {
+    list_init(&queue_);
+  }
+
+  // Return whether `key` hits
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    if (Node_t* e = lookup(key)) {
+      list_move(&queue_, e);
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (size_ == capacity_) evict(list_oldest(&queue_));
+    list_append(&queue_, insert(key, kv_size, 0));
+    return record(false, mode);
+  }
+};
+
+// Evict in insertion order; hits do not change the order
+class FifoCache : public PolicyCacheBase {
+  Node_t queue_;
+
+ public:
+  explicit FifoCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, 0, mr) {
+    list_init(&queue_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    if (Node_t* e = lookup(key)) {
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (size_ == capacity_) evict(list_oldest(&queue_));
+    list_append(&queue_, insert(key, kv_size, 0));
+    return record(false, mode);
+  }
+};
+
+// FIFO with a reference bit per key: a referenced key at the hand gets a
+// second chance, i.e., is moved to the newest end with its bit cleared
+class ClockCache : public PolicyCacheBase {
+  Node_t queue_;
+
+ public:
+  explicit ClockCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, 0, mr) {
+    list_init(&queue_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    if (Node_t* e = lookup(key)) {
+      e->value.freq = 1;
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (size_ == capacity_) {
+      Node_t* e = list_oldest(&queue_);
+      while (e->value.freq) {
+        e->value.freq = 0;
+        list_move(&queue_, e);
+        e = list_oldest(&queue_);
+      }
+      evict(e);
+    }
+    list_append(&queue_, insert(key, kv_size, 0));
+    return record(false, mode);
+  }
+};
+
+// SIEVE (Zhang et al., NSDI'24): like CLOCK, but a key that survives the hand
+// stays in place, and the hand moves from the oldest toward the newest keys
+class SieveCache : public PolicyCacheBase {
+  Node_t queue_;
+  Node_t* hand_;  // nullptr: start from the oldest
+
+ public:
+  explicit SieveCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, 0, mr), hand_(nullptr) {
+    list_init(&queue_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    if (Node_t* e = lookup(key)) {
+      e->value.freq = 1;
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (size_ == capacity_) {
+      Node_t* e = hand_ ? hand_ : list_oldest(&queue_);
+      while (e->value.freq) {
+        e->value.freq = 0;
+        e = newer(e);
+        if (e == &queue_) e = list_oldest(&queue_);
+      }
+      hand_ = newer(e) == &queue_ ? nullptr : newer(e);
+      evict(e);
+    }
+    list_append(&queue_, insert(key, kv_size, 0));
+    return record(false, mode);
+  }
+};
+
+// S3-FIFO (Yang et al., SOSP'23): new keys enter a small FIFO of 10% of the
+// capacity, and only those hit again there move to the main FIFO; the others
+// are remembered in a ghost FIFO, and a miss on a ghost goes to the main one
+// directly. The main FIFO reinserts keys hit since their last pass.
+class S3FifoCache : public PolicyCacheBase {
+  enum Queue : uint8_t { SMALL, MAIN, GHOST };
+  static constexpr uint32_t kMaxFreq = 3;
+
+  Node_t small_;
+  Node_t main_;
+  Node_t ghost_;
+  const size_t small_capacity_;
+  const size_t ghost_capacity_;
+  size_t small_size_;
+  size_t ghost_size_;
+
+  void evict_small() {
+    while (!list_empty(&small_)) {
+      Node_t* e = list_oldest(&small_);
+      --small_size_;
+      if (e->value.freq > 1) {
+        e->value.freq = 0;
+        e->value.queue = MAIN;
+        list_move(&main_, e);
+        continue;
+      }
+      demote(e);
+      e->value.queue = GHOST;
+      list_move(&ghost_, e);
+      if (++ghost_size_ > ghost_capacity_) {
+        remove(list_oldest(&ghost_));
+        --ghost_size_;
+      }
+      return;
+    }
+    evict_main();
+  }
+
+  void evict_main() {
+    while (true) {
+      Node_t* e = list_oldest(&main_);
+      if (!e->value.freq) {
+        evict(e);
+        return;
+      }
+      --e->value.freq;
+      list_move(&main_, e);
+    }
+  }
+
+ public:
+  explicit S3FifoCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, capacity - std::max<size_t>(capacity / 10, 1),
+                        mr),
+        small_capacity_(std::max<size_t>(capacity / 10, 1)),
+        ghost_capacity_(capacity - small_capacity_),
+        small_size_(0),
+        ghost_size_(0) {
+    list_init(&small_);
+    list_init(&main_);
+    list_init(&ghost_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    Node_t* e = lookup(key);
+    if (e && e->value.queue != GHOST) {
+      e->value.freq = std::min(e->value.freq + 1, kMaxFreq);
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    // forget the ghost first, since making room may push out the oldest one
+    bool was_ghost = e;
+    if (was_ghost) {
+      remove(e);
+      --ghost_size_;
+    }
+    if (size_ == capacity_) {
+      if (small_size_ >= small_capacity_ || list_empty(&main_))
+        evict_small();
+      else
+        evict_main();
+    }
+    if (was_ghost) {
+      list_append(&main_, insert(key, kv_size, MAIN));
+    } else {
+      list_append(&small_, insert(key, kv_size, SMALL));
+      ++small_size_;
+    }
+    return record(false, mode);
+  }
+};
+
+// 2Q (Johnson and Shasha, VLDB'94), the full version: new keys enter a FIFO
+// A1in of 25% of the capacity, and when pushed out are remembered in a ghost
+// FIFO A1out of half the capacity; a miss on A1out goes to the LRU list Am.
+class TwoQCache : public PolicyCacheBase {
+  enum Queue : uint8_t { A1IN, A1OUT, AM };
+
+  Node_t a1in_;
+  Node_t a1out_;
+  Node_t am_;
+  const size_t kin_;
+  const size_t kout_;
+  size_t a1in_size_;
+  size_t a1out_size_;
+
+  void reclaim() {
+    if (a1in_size_ > kin_ || list_empty(&am_)) {
+      Node_t* e = list_oldest(&a1in_);
+      --a1in_size_;
+      demote(e);
+      e->value.queue = A1OUT;
+      list_move(&a1out_, e);
+      if (++a1out_size_ > kout_) {
+        remove(list_oldest(&a1out_));
+        --a1out_size_;
+      }
+    } else {
+      evict(list_oldest(&am_));
+    }
+  }
+
+ public:
+  explicit TwoQCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, std::max<size_t>(capacity / 2, 1), mr),
+        kin_(std::max<size_t>(capacity / 4, 1)),
+        kout_(std::max<size_t>(capacity / 2, 1)),
+        a1in_size_(0),
+        a1out_size_(0) {
+    list_init(&a1in_);
+    list_init(&a1out_);
+    list_init(&am_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    Node_t* e = lookup(key);
+    if (e && e->value.queue != A1OUT) {
+      if (e->value.queue == AM) list_move(&am_, e);
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    bool was_ghost = e;
+    if (was_ghost) {
+      remove(e);
+      --a1out_size_;
+    }
+    if (size_ == capacity_) reclaim();
+    if (was_ghost) {
+      list_append(&am_, insert(key, kv_size, AM));
+    } else {
+      list_append(&a1in_, insert(key, kv_size, A1IN));
+      ++a1in_size_;
+    }
+    return record(false, mode);
+  }
+};
+
+// ARC (Megiddo and Modha, FAST'03): LRU lists T1 of keys seen once and T2 of
+// keys seen again, with ghost lists B1 and B2 of keys evicted from each; a
+// hit on a ghost shifts the target size of T1 toward the list it came from.
+class ArcCache : public PolicyCacheBase {
+  enum Queue : uint8_t { T1, T2, B1, B2 };
+
+  Node_t t1_, t2_, b1_, b2_;
+  size_t t1_size_, t2_size_, b1_size_, b2_size_;
+  size_t p_;  // target size of T1
+
+  void to_ghost(Node_t* e, Node_t* ghost, uint8_t queue) {
+    demote(e);
+    e->value.queue = queue;
+    list_move(ghost, e);
+  }
+
+  // Make room in the cache by moving the LRU key of T1 or T2 to its ghost
+  void replace(bool in_b2) {
+    if (t1_size_ &&
+        (t1_size_ > p_ || (in_b2 && t1_size_ == p_) || !t2_size_)) {
+      to_ghost(list_oldest(&t1_), &b1_, B1);
+      --t1_size_;
+      ++b1_size_;
+    } else {
+      to_ghost(list_oldest(&t2_), &b2_, B2);
+      --t2_size_;
+      ++b2_size_;
+    }
+  }
+
+  // A ghost hit becomes resident at the MRU end of T2
+  void revive(Node_t* e, uint32_t kv_size) {
+    admit(e, kv_size);
+    e->value.queue = T2;
+    list_move(&t2_, e);
+    ++t2_size_;
+  }
+
+ public:
+  explicit ArcCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : PolicyCacheBase(capacity, capacity, mr),
+        t1_size_(0),
+        t2_size_(0),
+        b1_size_(0),
+        b2_size_(0),
+        p_(0) {
+    list_init(&t1_);
+    list_init(&t2_);
+    list_init(&b1_);
+    list_init(&b2_);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    const size_t c = capacity_;
+    Node_t* e = lookup(key);
+    if (e && (e->value.queue == T1 || e->value.queue == T2)) {
+      if (e->value.queue == T1) {
+        --t1_size_;
+        ++t2_size_;
+        e->value.queue = T2;
+      }
+      list_move(&t2_, e);
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (e && e->value.queue == B1) {
+      p_ = std::min(p_ + std::max<size_t>(b2_size_ / b1_size_, 1), c);
+      replace(false);
+      --b1_size_;
+      revive(e, kv_size);
+      return record(false, mode);
+    }
+    if (e) {  // in B2
+      p_ -= std::min(p_, std::max<size_t>(b1_size_ / b2_size_, 1));
+      replace(true);
+      --b2_size_;
+      revive(e, kv_size);
+      return record(false, mode);
+    }
+
+    if (t1_size_ + b1_size_ == c) {
+      if (t1_size_ < c) {
+        remove(list_oldest(&b1_));
+        --b1_size_;
+        replace(false);
+      } else {
+        evict(list_oldest(&t1_));
+        --t1_size_;
+      }
+    } else if (t1_size_ + t2_size_ + b1_size_ + b2_size_ >= c) {
+      if (t1_size_ + t2_size_ + b1_size_ + b2_size_ == 2 * c) {
+        remove(list_oldest(&b2_));
+        --b2_size_;
+      }
+      replace(false);
+    }
+    list_append(&t1_, insert(key, kv_size, T1));
+    ++t1_size_;
+    return record(false, mode);
+  }
+};
+
+// LFU: evict the key with the fewest accesses while resident, the least
+// recently used among ties. Keys are kept in one list ordered by (count,
+// recency), with the newest key of each count indexed, so an access moves a
+// key right after the newest one of its new count in O(1). With `max_freq`,
+// counts saturate and keys at the cap are ordered by recency alone.
+class LfuCache : public PolicyCacheBase {
+  Node_t queue_;
+  // Map nodes come and go with every count change, so they are recycled from
+  // a pool rather than taken from `mr` directly, which may be an arena that
+  // never frees.
+  std::pmr::unsynchronized_pool_resource map_pool_;
+  std::pmr::unordered_map<uint32_t, Node_t*> newest_of_freq_;
+  const uint32_t max_freq_;
+
+  void touch(Node_t* e) {
+    uint32_t f = e->value.freq;
+    uint32_t g = f < max_freq_ ? f + 1 : f;
+    auto it = newest_of_freq_.find(f);
+    assert(it != newest_of_freq_.end());
+    Node_t* pos = it->second;
+    if (g != f) {
+      auto jt = newest_of_freq_.find(g);
+      if (jt != newest_of_freq_.end()) pos = jt->second;
+    }
+    if (it->second == e) {
+      Node_t* o = older(e);
+      if (o != &queue_ && o->value.freq == f)
+        it->second = o;
+      else
+        newest_of_freq_.erase(it);
+    }
+    if (pos != e) {
+      list_remove(e);
+      list_insert_after(pos, e);
+    }
+    e->value.freq = g;
+    newest_of_freq_[g] = e;
+  }
+
+ public:
+  explicit LfuCache(
+      size_t capacity,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource(),
+      uint32_t max_freq = std::numeric_limits<uint32_t>::max())
+      : PolicyCacheBase(capacity, 0, mr),
+        map_pool_(mr),
+        newest_of_freq_(&map_pool_),
+        max_freq_(max_freq) {
+    assert(max_freq > 0);
+    list_init(&queue_);
+    // no more counts than resident keys, so the buckets are never rehashed
+    newest_of_freq_.reserve(capacity);
+  }
+
+  bool access(uint32_t key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    if (Node_t* e = lookup(key)) {
+      touch(e);
+      resize(e, kv_size);
+      return record(true, mode);
+    }
+    if (size_ == capacity_) {
+      Node_t* victim = list_oldest(&queue_);
+      auto it = newest_of_freq_.find(victim->value.freq);
+      if (it->second == victim) newest_of_freq_.erase(it);
+      evict(victim);
+    }
+    Node_t* e = insert(key, kv_size, 0);
+    e->value.freq = 1;
+    auto it = newest_of_freq_.find(1);
+    list_insert_after(it != newest_of_freq_.end() ? it->second : &queue_, e);
+    newest_of_freq_[1] = e;
+    return record(false, mode);
+  }
+};
+
+}  // namespace gcache
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "ghost_cache.h"
+#include "policy_cache.h"
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * Simulate a key-value cache under an eviction policy (one of the simulators
+ * in policy_cache.h) at each of the cache sizes (in keys) min_count,
+ * min_count + tick, ..., max_count. It takes the same constructor arguments
+ * and gives the same curve as the other kv engines, but every access costs
+ * one access per size, since these policies have no stack property.
+ *
+ * A subset of a grid can be simulated by striding: e.g., with the tick
+ * multiplied by n and min_count offset by i * tick for i in [0, n), n
+ * instances cover the grid and can run on different threads.
+ */
+template <typename Policy, typename Hash = std::hash<std::string_view>>
+class PolicyKvCache {
+  const uint32_t tick;
+  const uint32_t min_count;
+  const uint32_t max_count;
+  std::pmr::memory_resource* mr;
+  std::pmr::vector<Policy*> caches;
+
+ public:
+  // All simulators are allocated from `mr`
+  PolicyKvCache(
+      uint32_t tick, uint32_t min_count, uint32_t max_count,
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : tick(tick),
+        min_count(min_count),
+        max_count(max_count),
+        mr(mr),
+        caches(mr) {
+    assert(tick > 0);
+    assert(min_count > 0 && min_count <= max_count);
+    std::pmr::polymorphic_allocator<Policy> alloc(mr);
+    for (uint32_t count = min_count; count <= max_count; count += tick)
+      caches.push_back(alloc.template new_object<Policy>(count, mr));
+  }
+  ~PolicyKvCache() {
+    std::pmr::polymorphic_allocator<Policy> alloc(mr);
+    for (Policy* c : caches) alloc.delete_object(c);
+  }
+  PolicyKvCache(const PolicyKvCache&) = delete;
+  PolicyKvCache& operator=(const PolicyKvCache&) = delete;
+
+  void access(const std::string_view key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    uint32_t key_hash = Hash{}(key);
+    access(key_hash, kv_size, mode);
+  }
+
+  void access(uint32_t key_hash, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    for (Policy* c : caches) c->access(key_hash, kv_size, mode);
+  }
+
+  [[nodiscard]] uint32_t get_tick() const { return tick; }
+  [[nodiscard]] uint32_t get_min_count() const { return min_count; }
+  [[nodiscard]] uint32_t get_max_count() const { return max_count; }
+  [[nodiscard]] double get_hit_rate(uint32_t count) {
+    return get_stat(count).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t count) {
+    return get_stat(count).get_miss_rate();
+  }
+  [[nodiscard]] const CacheStat& get_stat(uint32_t count) {
+    assert(count >= min_count && count <= max_count);
+    assert((count - min_count) % tick == 0);
+    return caches[(count - min_count) / tick]->get_stat();
+  }
+
+  void reset_stat() {
+    for (Policy* c : caches) c->reset_stat();
+  }
+
+  // The size of each point is the kv size resident in that cache
+  [[nodiscard]] const std::vector<std::tuple<
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve() const {
+    std::vector<std::tuple<uint32_t, uint64_t, CacheStat>> curve;
+    curve.reserve(caches.size());
+    // like a ghost cache, only report sizes that the working set could fill;
+    // nothing is evicted before a cache fills, so the largest one holds every
+    // key seen unless it is full
+    size_t distinct = caches.back()->size();
+    for (const Policy* c : caches) {
+      if (c->capacity() > distinct) break;
+      curve.emplace_back(c->capacity(), c->size_bytes(), c->get_stat());
+    }
+    return curve;
+  }
+};
+}  // namespace gcache
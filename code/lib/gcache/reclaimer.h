@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gcache {
+
+/**
+ * A background thread that keeps each tenant's free list in a SharedCache
+ * between a low and a high watermark, by evicting least recently used objects
+ * ahead of time, so that most inserts pop a free handle instead of evicting
+ * on the spot. Watermarks are fractions of each tenant's capacity in handles,
+ * but at least one handle; an insert still evicts by itself if the free list
+ * runs out between rounds.
+ *
+ * The cache is not thread-safe: every thread, including this one, must hold
+ * `mtx` while using it. The reclaimer holds it for one batch of evictions at a
+ * time and evicts at most one batch per tenant in each round, leaving the rest
+ * to the next round, which starts without waiting for the period if any is
+ * left, so a thread waits for at most one batch. `std::mutex` is
+ * not fair, so it also yields after each batch, or else it could take the
+ * mutex back before a waiter woken by the unlock gets to run.
+ *
+ * The tags are fixed at construction and should stay tenants of the cache
+ * while the reclaimer runs; a tag the cache does not have is skipped.
+ */
+template <typename Cache, typename Tag_t>
+class Reclaimer {
+ public:
+  Reclaimer(Cache& cache, std::mutex& mtx, std::vector<Tag_t> tags,
+            double low = 0.01, double high = 0.02, size_t batch = 256,
+            std::chrono::microseconds period = std::chrono::microseconds(100))
+      : cache_(cache),
+        mtx_(mtx),
+        tags_(std::move(tags)),
+        low_(low),
+        high_(std::max(low, high)),
+        batch_(batch),
+        period_(period),
+        refilling_(tags_.size(), false),
+        stopping_(false),
+        num_reclaimed_(0) {
+    assert(batch > 0);
+    worker_ = std::thread(&Reclaimer::run, this);
+  }
+  ~Reclaimer() { stop(); }
+  Reclaimer(const Reclaimer&) = delete;
+  Reclaimer(Reclaimer&&) = delete;
+  Reclaimer& operator=(const Reclaimer&) = delete;
+  Reclaimer& operator=(Reclaimer&&) = delete;
+
+  // Stop and join the thread; the cache is used without it afterwards
+  void stop();
+
+  // Number of objects evicted ahead of time so far
+  uint64_t num_reclaimed() const {
+    return num_reclaimed_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void run();
+  // Evict a batch of the i-th tenant's objects if its free list fell below the
+  // low watermark and has not yet reached the high one since then; return
+  // the number evicted
+  size_t refill(size_t i);
+
+  Cache& cache_;
+  std::mutex& mtx_;
+  const std::vector<Tag_t> tags_;
+  const double low_;
+  const double high_;
+  const size_t batch_;
+  const std::chrono::microseconds period_;
+  // Whether each tenant's free list is being refilled; only used by `run`
+  std::vector<bool> refilling_;
+
+  // Guard `stopping_` only; not the cache
+  std::mutex stop_mtx_;
+  std::condition_variable cv_;
+  bool stopping_;
+  std::atomic<uint64_t> num_reclaimed_;
+  std::thread worker_;
+};
+
+template <typename Cache, typename Tag_t>
+void Reclaimer<Cache, Tag_t>::stop() {
+  {
+    std::lock_guard<std::mutex> lock(stop_mtx_);
+    if (stopping_) return;
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  worker_.join();
+}
+
+template <typename Cache, typename Tag_t>
+void Reclaimer<Cache, Tag_t>::run() {
+  std::unique_lock<std::mutex> lock(stop_mtx_);
+  while (!stopping_) {
+    lock.unlock();
+    bool is_refilling = false;
+    for (size_t i = 0; i < tags_.size(); ++i) {
+      // let a thread woken by the unlock take the mutex before the next batch
+      if (refill(i)) std::this_thread::yield();
+      is_refilling |= refilling_[i];
+    }
+    lock.lock();
+    // the next round starts at once if a tenant is still short
+    if (!is_refilling)
+      cv_.wait_for(lock, period_, [this] { return stopping_; });
+  }
+}
+
+template <typename Cache, typename Tag_t>
+size_t Reclaimer<Cache, Tag_t>::refill(size_t i) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  Tag_t tag = tags_[i];
+  if (!cache_.has_tag(tag)) return 0;
+  size_t capacity = cache_.capacity_of(tag);
+  if (!capacity) return 0;
+  // at least one handle, or a tenant smaller than 1/low_ is never refilled
+  size_t low = std::max<size_t>(1, capacity * low_);
+  size_t high = std::max<size_t>(1, capacity * high_);
+  size_t num_free = cache_.num_free_of(tag);
+  if (!refilling_[i]) {
+    if (num_free >= low) return 0;
+    refilling_[i] = true;
+  }
+  size_t n = 0;
+  if (num_free < high) {
+    n = cache_.reclaim(tag, std::min(batch_, high - num_free));
+    num_reclaimed_.fetch_add(n, std::memory_order_relaxed);
+  }
+  // done unless short of the high watermark with more to evict
+  if (!n || num_free + n >= high) refilling_[i] = false;
+  return n;
+}
+
+}  // namespace gcache
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * A reuse (stack) distance histogram: an access counted in counts[i] hits in
+ * any LRU cache of at least bounds[i] keys, and misses in any cache of at most
+ * bounds[i - 1] keys (0 for i = 0). Accesses beyond the last bound, including
+ * cold misses, only count in `total`.
+ *
+ * With bounds 1, 2, 3, ..., this is a full-resolution histogram, from which
+ * the miss ratio of any cache size up to the last bound is exact; within a
+ * coarser bucket, hits are interpolated linearly.
+ */
+struct ReuseHistogram {
+  std::vector<uint32_t> bounds;  // strictly increasing
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+
+  [[nodiscard]] CacheStat get_stat(uint32_t count) const {
+    assert(bounds.size() == counts.size());
+    double hit_cnt = 0;
+    uint32_t lo = 0;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      if (bounds[i] <= count) {
+        hit_cnt += counts[i];
+      } else {
+        hit_cnt += static_cast<double>(counts[i]) * (count - lo) /
+                   (bounds[i] - lo);
+        break;
+      }
+      lo = bounds[i];
+    }
+    CacheStat stat;
+    stat.hit_cnt = std::min<uint64_t>(std::llround(hit_cnt), total);
+    stat.miss_cnt = total - stat.hit_cnt;
+    return stat;
+  }
+
+  // Merge buckets so that only bounds with at most `sub_bits + 1` significant
+  // bits remain: exact below 2^(sub_bits + 1), and each power of two beyond is
+  // split into 2^sub_bits buckets. A bucket is moved to the smallest such
+  // bound not below its own, so its hits are never credited to a smaller
+  // cache.
+  [[nodiscard]] ReuseHistogram log_bucketed(uint32_t sub_bits) const {
+    ReuseHistogram h;
+    h.total = total;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      uint64_t b = bounds[i];
+      uint32_t width = std::bit_width(b);
+      if (width > sub_bits + 1) {
+        uint32_t shift = width - sub_bits - 1;
+        b = ((b + (uint64_t{1} << shift) - 1) >> shift) << shift;
+      }
+      uint32_t bound = std::min<uint64_t>(b, UINT32_MAX);
+      if (!h.bounds.empty() && h.bounds.back() == bound) {
+        h.counts.back() += counts[i];
+      } else {
+        h.bounds.push_back(bound);
+        h.counts.push_back(counts[i]);
+      }
+    }
+    return h;
+  }
+};
+}  // namespace gcache
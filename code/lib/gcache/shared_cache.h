@@ -1,6 +1,11 @@
 #pragma once
 #include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "lru_cache.h"
@@ -8,9 +13,6 @@
 
 namespace gcache {
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-class SharedCache;
-
 template <typename Tag_t, typename Value_t>
 struct TaggedValue {
   Tag_t tag;
@@ -47,6 +49,7 @@ class TaggedHandle
 
   Key_t get_key() const { return node->key; }
   Tag_t get_tag() const { return node->value.tag; }
+  uint32_t get_size() const { return node->get_size(); }
 
  protected:
   void set_tag(Tag_t tag) { node->value.tag = tag; }
@@ -54,13 +57,44 @@ class TaggedHandle
   // only visible to SharedCache: converted into LRUHandle
   LRUHandle<Key_t, TaggedValue_t> untagged() { return node; }
 
-  template <typename T, typename K, typename V, typename H>
+  template <typename T, typename K, typename V, typename H, EvictMode M>
   friend class SharedCache;
 };
 
+// Counters of a tenant in a SharedCache, padded to a cache line so tenants
+// updated from different cores do not share one. They are plain integers, as
+// the cache is only used by one thread at a time (see Reclaimer); read them
+// the same way.
+struct alignas(64) TenantStat {
+  uint64_t hits = 0;         // on its objects, or any object if tagged; an
+                             // insert of an existing key is a hit too
+  uint64_t misses = 0;       // by tagged lookups and inserts not hinted
+                             // nonexistent; an untagged lookup has no tenant
+                             // to charge
+  uint64_t shared_hits = 0;  // tagged hits on other tenants' objects
+  uint64_t inserts = 0;
+  uint64_t evictions = 0;      // of its objects, to make room for any reason
+  uint64_t relocated_in = 0;   // handles, or bytes in byte-capacity mode
+  uint64_t relocated_out = 0;  // same as above
+  uint64_t pinned = 0;         // pins not yet released
+};
+static_assert(sizeof(TenantStat) == 64);
+
+// What a lookup by one tenant does to an object that another tenant owns
+enum class SharedHit {
+  // Return it but leave its owner's eviction order alone, so the owner is not
+  // made to keep it for others; the cost stays with the owner
+  NO_REFRESH,
+  // Charge it to the most recent accessor: move it to the caller's cache as
+  // most recently used, in exchange for one of the caller's slots
+  MIGRATE,
+};
+
 // Each tenant should have a "tag" which uniquely identifies this tenant. Tag
-// should be a lightweight type to copy.
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
+// should be a lightweight type to copy. Every tenant's cache evicts by `Mode`;
+// see LRUCache.
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
 class SharedCache {
  private:
   using TaggedValue_t = TaggedValue<Tag_t, Value_t>;
@@ -68,10 +102,26 @@ class SharedCache {
 
  public:
   using Handle_t = TaggedHandle<Tag_t, Key_t, Value_t>;
-  using LRUCache_t = LRUCache<Key_t, TaggedValue_t, Hash>;
-
-  SharedCache() : pool_(nullptr), table_(), tenant_cache_map_(){};
-  ~SharedCache() { delete[] pool_; };
+  using LRUCache_t = LRUCache<Key_t, TaggedValue_t, Hash, Mode>;
+
+  // The handle pool and table are allocated from `mr`, which must outlive
+  // the cache; e.g., a PageResource places them on huge pages or a NUMA node.
+  explicit SharedCache(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : pool_(nullptr),
+        pool_size_(0),
+        total_capacity_(0),
+        has_foreign_(false),
+        table_(mr),
+        tenant_cache_map_(),
+        by_bytes_(false),
+        mr_(mr){};
+  ~SharedCache() {
+    if (!pool_) return;
+    std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+    std::destroy_n(pool_, pool_size_);
+    alloc.deallocate(pool_, pool_size_);
+  };
   SharedCache(const SharedCache&) = delete;
   SharedCache(SharedCache&&) = delete;
   SharedCache& operator=(const SharedCache&) = delete;
@@ -81,6 +131,15 @@ class SharedCache {
   template <typename Fn>
   void init(const std::vector<std::pair<Tag_t, size_t>>& tenant_configs,
             Fn&& fn);
+  // Byte-capacity mode: each tenant's config is (tag, slots, bytes); it gets
+  // `slots` handles, which bound its number of objects, and a budget of
+  // `bytes`, which bounds their total size (see LRUCache::init_bytes);
+  // `relocate` then moves bytes of budget.
+  void init_bytes(
+      const std::vector<std::tuple<Tag_t, size_t, size_t>>& tenant_configs);
+  // Start every tenant's cache with no handles, to be added later by `adopt`
+  // from memory the caller manages; the table is sized for `max_handles`.
+  void init_empty(const std::vector<Tag_t>& tags, size_t max_handles);
 
   size_t capacity() const { return total_capacity_; }
   // Note no `size()` is provided here, because it is unclear how useful to know
@@ -91,8 +150,19 @@ class SharedCache {
   size_t capacity_of(Tag_t tag) const;
   // Return the current cache size associated with the given tag
   size_t size_of(Tag_t tag) const;
-
-  // For each item in the cache, call fn(key, handle)
+  // Same as above in bytes
+  size_t capacity_bytes_of(Tag_t tag) const;
+  size_t size_bytes_of(Tag_t tag) const;
+  // Return the number of free handles of the tag
+  size_t num_free_of(Tag_t tag) const;
+  // Whether the tag is one of the tenants'
+  bool has_tag(Tag_t tag) const { return tenant_cache_map_.contains(tag); }
+
+  // For each item in the cache, call fn(key, handle) in no particular order;
+  // scans the shared handle pool sequentially instead of walking each
+  // tenant's lists, so the cost is bounded by memory bandwidth. Once `adopt`
+  // gives a tenant a handle from outside the pool (e.g., after `init_empty`),
+  // it walks the lists instead.
   template <typename Fn>
   void for_each(Fn&& fn);
 
@@ -100,45 +170,140 @@ class SharedCache {
   // tenant_configs); the behavior is undefined if not.
 
   // Insert a handle into cache with given key and hash if not exists; if does,
-  // return the existing one
+  // return the existing one. Unless hinted nonexistent, the lookup counts as
+  // a hit of the owner or a miss of `tag`.
   Handle_t insert(Tag_t tag, Key_t key, bool pin = false,
                   bool hint_nonexist = false);
+  // Insert an object of `size` bytes, or update the size of the existing one
+  // (which is charged to the tenant that inserted it); return nullptr if it
+  // cannot fit; see LRUCache::insert_sized
+  Handle_t insert_sized(Tag_t tag, Key_t key, uint32_t size, bool pin = false,
+                        bool hint_nonexist = false);
+  // Update the size of a handle's object; see LRUCache::resize
+  bool resize(Handle_t handle, uint32_t size);
   // Search for a handle; return nullptr if not exist; no tag required because
   // there is no insertion may happen
-  // FIXME: However, this op will refresh LRU list, so a tenant A could
+  // However, this op refreshes the owner's LRU list, so a tenant A could
   // repeatedly access a cache slot previously accessed by B and keep this slot
-  // in memory, even though B does not use it anymore
+  // in memory, even though B does not use it anymore; use the lookup below to
+  // attribute accesses to the caller instead.
   Handle_t lookup(Key_t key, bool pin = false);
+  // Search for a handle on behalf of tenant `tag`: a hit on its own object is
+  // the same as above; a hit on another tenant's object is counted in
+  // `shared_hits_of(tag)` and handled by `mode` (if MIGRATE cannot take a slot
+  // of the caller's, as NO_REFRESH). Pinning an object still refreshes it in
+  // its owner's cache on release.
+  Handle_t lookup(Tag_t tag, Key_t key, bool pin = false,
+                  SharedHit mode = SharedHit::NO_REFRESH);
   // Release pinned handle returned by insert/lookup
   void release(Handle_t handle);
   // Pin a handle returned by insert/lookup
   void pin(Handle_t handle);
+  // Evict up to `n` of a tenant's objects ahead of its inserts; see
+  // LRUCache::reclaim and Reclaimer
+  size_t reclaim(Tag_t tag, size_t n);
+  // Count a miss of a tenant that looked up by the untagged `lookup`, e.g., to
+  // pick which of its caches to insert into
+  void count_miss(Tag_t tag) { ++get_tenant(tag).stat.misses; }
   // `touch` is not implemented yet because it is mostly used on GhostCache and
   // it is unclear whether it is useful in the real cache
 
   // Relocate some handles (i.e. cache slots) from src to dst; the relocation
   // may be terminated early if src does not have enough available handles to
-  // return; return number of handles relocated successfully
+  // return; return number of handles relocated successfully. Handles move in
+  // bulk: src's free handles and its evicted ones are each spliced as one
+  // segment, which costs O(1) plus a table removal per evicted object. In
+  // byte-capacity mode, relocate `size` bytes of budget instead, evicting from
+  // src as needed; return number of bytes relocated.
   size_t relocate(Tag_t src, Tag_t dst, size_t size);
 
+  // Fair-share mode: set the target capacity of each tenant listed, e.g., as
+  // computed by a policy in fair_share.h. Capacities then move to the targets
+  // lazily: a tenant under its target that inserts into its full cache takes a
+  // slot from a tenant over its target, evicting that tenant's object instead
+  // of its own. Nothing moves while targets are met, and no pass over all
+  // tenants is ever needed. Tenants not listed keep their capacity. Call it
+  // again after `relocate` to move on from the relocated capacities. Not
+  // supported in byte-capacity mode.
+  void set_targets(const std::vector<std::pair<Tag_t, size_t>>& targets);
+  // Return the target capacity of a tenant, or its capacity if it has none
+  size_t target_of(Tag_t tag) const;
+
   // Similar to LRUCache erase/install
   bool erase(Handle_t handle);
   Handle_t install(Tag_t tag, Key_t key);
 
+  // Take a handle (cache slot) out of its tenant's cache, dropping its key if
+  // it has one, so that the caller can reuse it, e.g., give it to another
+  // tenant by `adopt`; fail if pinned. The handle must not be erased. A key
+  // dropped counts as an eviction of its owner, unless the caller removes it
+  // on purpose (`is_eviction` false).
+  bool retire(Handle_t handle, bool is_eviction = true);
+  // Whether `retire` would fail on a handle for being pinned
+  bool is_pinned(Handle_t handle) const { return handle.node->refs > 1; }
+  // Give a handle not in any cache (e.g., retired, or constructed by the
+  // caller) to tag's cache as a free slot; the caller owns its memory and must
+  // retire it before freeing it.
+  void adopt(Tag_t tag, Handle_t handle);
+
   // Return a read-only access to the LRU cache associated with the tag
   const LRUCache_t& get_cache(Tag_t tag) const;
+  // Number of hits of a tenant on objects other tenants own
+  uint64_t shared_hits_of(Tag_t tag) const { return stat_of(tag).shared_hits; }
+
+  // Return the counters of a tenant
+  const TenantStat& stat_of(Tag_t tag) const;
+  // Return a copy of every tenant's counters, in no particular order
+  std::vector<std::pair<Tag_t, TenantStat>> get_stats() const;
+  // Zero every tenant's counters but `pinned`, which is a level
+  void reset_stats();
 
  private:
   Node_t* lookup_impl(Key_t key, uint32_t hash, bool pin);
 
-  LRUCache_t& get_cache_mutable(Tag_t tag);
+  struct Tenant {
+    LRUCache_t cache;
+    // `stat.evictions` is only brought up to date from the cache's count, less
+    // `evictions_base`, when read
+    mutable TenantStat stat;
+    uint64_t evictions_base = 0;  // the cache's count at the last reset
+
+    const TenantStat& sync_stat() const {
+      stat.evictions = cache.num_evicted() - evictions_base;
+      return stat;
+    }
+  };
+
+  Tenant& get_tenant(Tag_t tag);
+  LRUCache_t& get_cache_mutable(Tag_t tag) { return get_tenant(tag).cache; }
+  // In fair-share mode, give a slot from a tenant over its target to one
+  // under its target whose cache is full
+  void steal(Tag_t tag, LRUCache_t& cache);
 
   Node_t* pool_;
+  // Number of handles in `pool_`; `total_capacity_` may drift from it due to
+  // `erase`/`install` and `retire`/`adopt`
+  size_t pool_size_;
   size_t total_capacity_;
+  // Whether `adopt` has taken a handle not in `pool_`, which a scan of the
+  // pool would miss
+  bool has_foreign_;
   NodeTable<Key_t, TaggedValue_t> table_;
 
-  // Map each tenant's tag to its own cache; must be const after `init`
-  std::unordered_map<Tag_t, LRUCache_t> tenant_cache_map_;
+  // Map each tenant's tag to its own cache and counters; must be const after
+  // `init`
+  std::unordered_map<Tag_t, Tenant> tenant_cache_map_;
+
+  // Whether initialized by `init_bytes`
+  bool by_bytes_;
+
+  // Target capacities in fair-share mode, and the tenants that were over
+  // their targets, to steal from in turn; a tenant is dropped once it is not
+  std::unordered_map<Tag_t, size_t> targets_;
+  std::vector<Tag_t> donors_;
+
+  // Where `pool_` and `table_` are allocated from.
+  std::pmr::memory_resource* mr_;
 
  public:  // for debugging
   std::ostream& print(std::ostream& os, int indent = 0) const;
@@ -147,60 +312,138 @@ class SharedCache {
   }
 };
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-void SharedCache<Tag_t, Key_t, Value_t, Hash>::init(
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::init(
     const std::vector<std::pair<Tag_t, size_t>>& tenant_configs) {
   total_capacity_ = 0;
   size_t begin_idx = 0;
   for (auto [tag, capacity] : tenant_configs) total_capacity_ += capacity;
 
   table_.init(total_capacity_);
-  pool_ = new Node_t[total_capacity_];
+  std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+  pool_size_ = total_capacity_;
+  pool_ = alloc.allocate(pool_size_);
+  std::uninitialized_default_construct_n(pool_, pool_size_);
   for (auto [tag, capacity] : tenant_configs) {
     auto [it, is_emplaced] = tenant_cache_map_.emplace(
         std::piecewise_construct, std::forward_as_tuple(tag),
         std::forward_as_tuple());
     assert(is_emplaced);
-    it->second.init_from(&pool_[begin_idx], &table_, capacity);
+    it->second.cache.init_from(&pool_[begin_idx], &table_, capacity);
     begin_idx += capacity;
   }
   assert(begin_idx == total_capacity_);
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
 template <typename Fn>
-inline void SharedCache<Tag_t, Key_t, Value_t, Hash>::init(
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::init(
     const std::vector<std::pair<Tag_t, size_t>>& tenant_configs, Fn&& fn) {
   init(tenant_configs);
-  for (size_t i = 0; i < total_capacity_; ++i) {
+  for (size_t i = 0; i < pool_size_; ++i) {
     fn(&pool_[i]);
   }
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-size_t SharedCache<Tag_t, Key_t, Value_t, Hash>::capacity_of(Tag_t tag) const {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::init_bytes(
+    const std::vector<std::tuple<Tag_t, size_t, size_t>>& tenant_configs) {
+  std::vector<std::pair<Tag_t, size_t>> slot_configs;
+  slot_configs.reserve(tenant_configs.size());
+  for (auto [tag, slots, bytes] : tenant_configs)
+    slot_configs.emplace_back(tag, slots);
+  init(slot_configs);
+  for (auto [tag, slots, bytes] : tenant_configs)
+    get_cache_mutable(tag).byte_capacity_ = bytes;
+  by_bytes_ = true;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::init_empty(
+    const std::vector<Tag_t>& tags, size_t max_handles) {
+  table_.init(max_handles);
+  for (Tag_t tag : tags) {
+    auto [it, is_emplaced] = tenant_cache_map_.emplace(
+        std::piecewise_construct, std::forward_as_tuple(tag),
+        std::forward_as_tuple());
+    assert(is_emplaced);
+    it->second.cache.init_from(nullptr, &table_, 0);
+  }
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::capacity_of(
+    Tag_t tag) const {
   assert(tenant_cache_map_.contains(tag));
   return get_cache(tag).capacity();
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-size_t SharedCache<Tag_t, Key_t, Value_t, Hash>::size_of(Tag_t tag) const {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::size_of(
+    Tag_t tag) const {
   assert(tenant_cache_map_.contains(tag));
   return get_cache(tag).size();
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::capacity_bytes_of(
+    Tag_t tag) const {
+  assert(tenant_cache_map_.contains(tag));
+  return get_cache(tag).capacity_bytes();
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::size_bytes_of(
+    Tag_t tag) const {
+  assert(tenant_cache_map_.contains(tag));
+  return get_cache(tag).size_bytes();
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::num_free_of(
+    Tag_t tag) const {
+  assert(tenant_cache_map_.contains(tag));
+  return get_cache(tag).num_free();
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
 template <typename Fn>
-inline void SharedCache<Tag_t, Key_t, Value_t, Hash>::for_each(Fn&& fn) {
-  for (auto& [tag, cache] : tenant_cache_map_) {
-    cache.for_each(fn);
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::for_each(Fn&& fn) {
+  if (has_foreign_) {
+    for (auto& [tag, tenant] : tenant_cache_map_) {
+      tenant.cache.for_each_lru(fn);
+      tenant.cache.for_each_in_use(fn);
+    }
+    return;
+  }
+  // a handle is in some tenant's lru or in-use list iff refs > 0; handles
+  // relocated between tenants stay in this pool
+  for (size_t i = 0; i < pool_size_; ++i) {
+    if (pool_[i].refs) fn(&pool_[i]);
+  }
+  for (auto& [tag, tenant] : tenant_cache_map_) {
+    for (auto e : tenant.cache.extra_pool_) {
+      if (e->refs) fn(e);
+    }
   }
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline typename SharedCache<Tag_t, Key_t, Value_t, Hash>::Handle_t
-SharedCache<Tag_t, Key_t, Value_t, Hash>::insert(Tag_t tag, Key_t key, bool pin,
-                                                 bool hint_nonexist) {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::insert(Tag_t tag, Key_t key,
+                                                       bool pin,
+                                                       bool hint_nonexist) {
   uint32_t hash = Hash{}(key);
   assert(tenant_cache_map_.contains(tag));
 
@@ -208,81 +451,232 @@ SharedCache<Tag_t, Key_t, Value_t, Hash>::insert(Tag_t tag, Key_t key, bool pin,
   if (!hint_nonexist) {
     e = lookup_impl(key, hash, pin);
     if (e) return e;
+    ++get_tenant(tag).stat.misses;
   } else {
     assert(!table_.lookup(key, hash));
   }
 
   // The key does not exist in the cache, perform insertion
-  e = get_cache_mutable(tag).insert_impl(key, hash, pin, /*not_exist*/ true);
+  Tenant& t = get_tenant(tag);
+  steal(tag, t.cache);
+  e = t.cache.insert_impl(key, hash, pin, /*not_exist*/ true);
+  if (!e) return nullptr;
+  ++t.stat.inserts;
+  t.stat.pinned += pin;
+  Handle_t h(e);
+  h.set_tag(tag);
+  return h;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::insert_sized(
+    Tag_t tag, Key_t key, uint32_t size, bool pin, bool hint_nonexist) {
+  uint32_t hash = Hash{}(key);
+  assert(tenant_cache_map_.contains(tag));
+
+  Node_t* e;
+  if (!hint_nonexist) {
+    e = lookup_impl(key, hash, pin);
+    if (e) {
+      Tenant& owner = get_tenant(Handle_t(e).get_tag());
+      e = owner.cache.resize_impl(e, size, pin);
+      if (!e) owner.stat.pinned -= pin;  // undone by resize_impl
+      return e;
+    }
+    ++get_tenant(tag).stat.misses;
+  } else {
+    assert(!table_.lookup(key, hash));
+  }
+
+  Tenant& t = get_tenant(tag);
+  steal(tag, t.cache);
+  e = t.cache.insert_impl(key, hash, pin, /*not_exist*/ true, size);
   if (!e) return nullptr;
+  ++t.stat.inserts;
+  t.stat.pinned += pin;
   Handle_t h(e);
   h.set_tag(tag);
   return h;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline typename SharedCache<Tag_t, Key_t, Value_t, Hash>::Handle_t
-SharedCache<Tag_t, Key_t, Value_t, Hash>::lookup(Key_t key, bool pin) {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline bool SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::resize(
+    Handle_t handle, uint32_t size) {
+  return get_cache_mutable(handle.get_tag())
+      .resize_impl(handle.untagged().node, size, /*pin*/ false);
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::lookup(Key_t key, bool pin) {
   return lookup_impl(key, Hash{}(key), pin);
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline typename SharedCache<Tag_t, Key_t, Value_t, Hash>::Node_t*
-SharedCache<Tag_t, Key_t, Value_t, Hash>::lookup_impl(Key_t key, uint32_t hash,
-                                                      bool pin) {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::lookup(Tag_t tag, Key_t key,
+                                                       bool pin,
+                                                       SharedHit mode) {
+  Tenant& t = get_tenant(tag);
+  Node_t* e = table_.lookup(key, Hash{}(key));
+  if (!e) {
+    ++t.stat.misses;
+    return nullptr;
+  }
+
+  ++t.stat.hits;
+  Handle_t h(e);
+  Tag_t owner_tag = h.get_tag();
+  if (owner_tag == tag) {
+    t.cache.lookup_refresh(e, pin);
+    t.stat.pinned += pin;
+    return h;
+  }
+  ++t.stat.shared_hits;
+  Tenant& owner = get_tenant(owner_tag);
+  uint64_t pins = e->refs - 1;  // move with the object if it migrates
+  if (mode == SharedHit::MIGRATE && owner.cache.migrate(e, t.cache, pin)) {
+    h.set_tag(tag);
+    owner.stat.pinned -= pins;
+    t.stat.pinned += pins + pin;
+  } else {
+    if (pin) {
+      owner.cache.pin(h.untagged());
+      ++owner.stat.pinned;
+    }
+  }
+  return h;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Node_t*
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::lookup_impl(Key_t key,
+                                                            uint32_t hash,
+                                                            bool pin) {
   Node_t* e = table_.lookup(key, hash);
   if (!e) return nullptr;
 
-  Tag_t tag = Handle_t(e).get_tag();
-  assert(tenant_cache_map_.contains(tag));
-  get_cache_mutable(tag).lookup_refresh(e, pin);
+  Tenant& t = get_tenant(Handle_t(e).get_tag());
+  t.cache.lookup_refresh(e, pin);
+  ++t.stat.hits;
+  t.stat.pinned += pin;
   return e;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline void SharedCache<Tag_t, Key_t, Value_t, Hash>::release(Handle_t handle) {
-  Tag_t tag = handle.get_tag();
-  assert(tenant_cache_map_.contains(tag));
-  get_cache_mutable(tag).release(handle.untagged());
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::release(
+    Handle_t handle) {
+  Tenant& t = get_tenant(handle.get_tag());
+  t.cache.release(handle.untagged());
+  --t.stat.pinned;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline void SharedCache<Tag_t, Key_t, Value_t, Hash>::pin(
-    typename SharedCache<Tag_t, Key_t, Value_t, Hash>::Handle_t handle) {
-  Tag_t tag = handle.get_tag();
-  assert(tenant_cache_map_.contains(tag));
-  get_cache_mutable(tag).pin(handle.untagged());
-}
-
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline size_t SharedCache<Tag_t, Key_t, Value_t, Hash>::relocate(Tag_t src,
-                                                                 Tag_t dst,
-                                                                 size_t size) {
-  assert(tenant_cache_map_.contains(src));
-  assert(tenant_cache_map_.contains(dst));
-
-  auto& src_cache = tenant_cache_map_[src];
-  auto& dst_cache = tenant_cache_map_[dst];
-  size_t n = 0;
-  for (; n < size; ++n) {
-    auto e = src_cache.preempt();
-    if (!e) break;
-    dst_cache.assign(e);
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::pin(
+    typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t handle) {
+  Tenant& t = get_tenant(handle.get_tag());
+  t.cache.pin(handle.untagged());
+  ++t.stat.pinned;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::reclaim(
+    Tag_t tag, size_t n) {
+  return get_cache_mutable(tag).reclaim(n);
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::relocate(
+    Tag_t src, Tag_t dst, size_t size) {
+  Tenant& s = get_tenant(src);
+  Tenant& d = get_tenant(dst);
+  size_t n;
+  if (by_bytes_) {
+    n = s.cache.preempt_bytes(size);
+    d.cache.assign_bytes(n);
+  } else {
+    // in bulk, so a large relocation splices lists instead of moving handles
+    // one at a time
+    Node_t* first;
+    Node_t* last;
+    n = s.cache.preempt_bulk(size, first, last);
+    if (n) d.cache.assign_bulk(first, last, n);
   }
+  s.stat.relocated_out += n;
+  d.stat.relocated_in += n;
   return n;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline bool SharedCache<Tag_t, Key_t, Value_t, Hash>::erase(Handle_t handle) {
-  assert(tenant_cache_map_.contains(handle.get_tag()));
-  bool is_erased = tenant_cache_map_[handle.get_tag()].erase(handle.untagged());
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::set_targets(
+    const std::vector<std::pair<Tag_t, size_t>>& targets) {
+  assert(!by_bytes_);
+  targets_.clear();
+  donors_.clear();
+  for (auto [tag, target] : targets) {
+    assert(tenant_cache_map_.contains(tag));
+    targets_[tag] = target;
+    if (get_cache(tag).capacity() > target) donors_.push_back(tag);
+  }
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+size_t SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::target_of(
+    Tag_t tag) const {
+  auto it = targets_.find(tag);
+  return it == targets_.end() ? capacity_of(tag) : it->second;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::steal(
+    Tag_t tag, LRUCache_t& cache) {
+  // a free slot or no donor left: nothing to do, at the cost of a branch
+  if (donors_.empty() || cache.size() < cache.capacity()) return;
+  auto it = targets_.find(tag);
+  if (it == targets_.end() || cache.capacity() >= it->second) return;
+  while (!donors_.empty()) {
+    Tag_t donor_tag = donors_.back();
+    Tenant& donor = get_tenant(donor_tag);
+    if (donor.cache.capacity() > targets_[donor_tag]) {
+      auto e = donor.cache.preempt();
+      if (e) {
+        ++donor.stat.relocated_out;
+        ++get_tenant(tag).stat.relocated_in;
+        cache.assign(e);
+        return;
+      }
+    }
+    // at its target, or every object of it is pinned
+    donors_.pop_back();
+  }
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline bool SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::erase(
+    Handle_t handle) {
+  bool is_erased = get_cache_mutable(handle.get_tag()).erase(handle.untagged());
   if (is_erased) --total_capacity_;
   return is_erased;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline typename SharedCache<Tag_t, Key_t, Value_t, Hash>::Handle_t
-SharedCache<Tag_t, Key_t, Value_t, Hash>::install(Tag_t tag, Key_t key) {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Handle_t
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::install(Tag_t tag, Key_t key) {
   assert(tenant_cache_map_.contains(tag));
   Node_t* e = get_cache_mutable(tag).install_impl(key);
   Handle_t h(e);
@@ -291,29 +685,88 @@ SharedCache<Tag_t, Key_t, Value_t, Hash>::install(Tag_t tag, Key_t key) {
   return h;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline const typename SharedCache<Tag_t, Key_t, Value_t, Hash>::LRUCache_t&
-SharedCache<Tag_t, Key_t, Value_t, Hash>::get_cache(Tag_t tag) const {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline bool SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::retire(
+    Handle_t handle, bool is_eviction) {
+  Tag_t tag = handle.get_tag();
   assert(tenant_cache_map_.contains(tag));
-  return tenant_cache_map_.find(tag)->second;
+  if (!get_cache_mutable(tag).retire(handle.untagged().node, is_eviction))
+    return false;
+  --total_capacity_;
+  return true;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::adopt(
+    Tag_t tag, Handle_t handle) {
+  assert(tenant_cache_map_.contains(tag));
+  Node_t* e = handle.untagged().node;
+  std::less<const Node_t*> before;
+  if (before(e, pool_) || !before(e, pool_ + pool_size_)) has_foreign_ = true;
+  handle.set_tag(tag);
+  get_cache_mutable(tag).assign(handle.untagged());
+  ++total_capacity_;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline const typename SharedCache<Tag_t, Key_t, Value_t, Hash,
+                                  Mode>::LRUCache_t&
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::get_cache(Tag_t tag) const {
+  assert(tenant_cache_map_.contains(tag));
+  return tenant_cache_map_.find(tag)->second.cache;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline const TenantStat& SharedCache<Tag_t, Key_t, Value_t, Hash,
+                                     Mode>::stat_of(Tag_t tag) const {
+  assert(tenant_cache_map_.contains(tag));
+  return tenant_cache_map_.find(tag)->second.sync_stat();
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+std::vector<std::pair<Tag_t, TenantStat>>
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::get_stats() const {
+  std::vector<std::pair<Tag_t, TenantStat>> stats;
+  stats.reserve(tenant_cache_map_.size());
+  for (auto& [tag, tenant] : tenant_cache_map_)
+    stats.emplace_back(tag, tenant.sync_stat());
+  return stats;
+}
+
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+void SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::reset_stats() {
+  for (auto& [tag, tenant] : tenant_cache_map_) {
+    uint64_t pinned = tenant.stat.pinned;
+    tenant.stat = TenantStat();
+    tenant.stat.pinned = pinned;
+    tenant.evictions_base = tenant.cache.num_evicted();
+  }
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline typename SharedCache<Tag_t, Key_t, Value_t, Hash>::LRUCache_t&
-SharedCache<Tag_t, Key_t, Value_t, Hash>::get_cache_mutable(Tag_t tag) {
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline typename SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::Tenant&
+SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::get_tenant(Tag_t tag) {
   assert(tenant_cache_map_.contains(tag));
   return tenant_cache_map_.find(tag)->second;
 }
 
-template <typename Tag_t, typename Key_t, typename Value_t, typename Hash>
-inline std::ostream& SharedCache<Tag_t, Key_t, Value_t, Hash>::print(
+template <typename Tag_t, typename Key_t, typename Value_t, typename Hash,
+          EvictMode Mode>
+inline std::ostream& SharedCache<Tag_t, Key_t, Value_t, Hash, Mode>::print(
     std::ostream& os, int indent) const {
   os << "Tenant Cache Map {" << std::endl;
-  for (auto& [tag, cache] : tenant_cache_map_) {
+  for (auto& [tag, tenant] : tenant_cache_map_) {
     for (int i = 0; i < indent + 1; ++i) os << '\t';
     os << "Tenant (tag=" << tag << ") {\n";
     for (int i = 0; i < indent + 2; ++i) os << '\t';
-    cache.print(os, indent + 2);
+    tenant.cache.print(os, indent + 2);
     for (int i = 0; i < indent + 1; ++i) os << '\t';
     os << "}\n";
   }
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "node.h"
+#include "shared_cache.h"
+
+namespace gcache {
+
+// Where an item's value is stored: a chunk in a slab page
+struct SlabItem {
+  char* data;
+  uint32_t page;  // index of the page the chunk is in
+};
+
+/**
+ * A multi-tenant key-value cache that stores values in slabs, as memcached
+ * does: memory is split into pages (1 MiB by default), and a page is carved
+ * into chunks of one size class when a class first needs room; chunk sizes
+ * grow by `factor` from `min_chunk` up to a page. An item takes a chunk of the
+ * smallest class that fits it, so there is no allocation per item, and memory
+ * is only lost to the slack in chunks.
+ *
+ * Each (tenant, class) pair is a cache of its own in a SharedCache, tagged by
+ * `make_tag`, whose slots are the chunks of that class in the tenant's pages;
+ * each slot is a handle whose value points at its chunk, and the handles of a
+ * page are allocated along with it. A class evicts its least recently used
+ * item (or by CLOCK, as `Mode` says) when it has no free chunk and its tenant
+ * has no page left to carve. Pages move between the classes of a tenant by
+ * `rebalance` and between tenants by `relocate`; either way, the items in a
+ * moved page are evicted.
+ *
+ * A value is up to a page long; the caller writes it to `handle->data` after
+ * `insert`, and `handle.get_size()` is its length.
+ */
+template <typename Key_t, typename Hash, EvictMode Mode = EvictMode::LRU>
+class SlabCache {
+ public:
+  using Shared_t = SharedCache<uint64_t, Key_t, SlabItem, Hash, Mode>;
+  using Handle_t = typename Shared_t::Handle_t;
+
+  // The pages and their handles are allocated from `mr`, which must outlive
+  // the cache; e.g., a PageResource places them on huge pages.
+  explicit SlabCache(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : shared_(mr), page_size_(0), mr_(mr) {}
+  ~SlabCache();
+  SlabCache(const SlabCache&) = delete;
+  SlabCache(SlabCache&&) = delete;
+  SlabCache& operator=(const SlabCache&) = delete;
+  SlabCache& operator=(SlabCache&&) = delete;
+
+  // Each tenant's config is (tenant, pages): the number of pages it may hold
+  void init(const std::vector<std::pair<uint32_t, size_t>>& tenant_configs,
+            uint32_t page_size = 1 << 20, uint32_t min_chunk = 64,
+            double factor = 1.25);
+
+  // Tag of a tenant's cache of a class in the SharedCache
+  static uint64_t make_tag(uint32_t tenant, uint8_t cls) {
+    return (static_cast<uint64_t>(tenant) << 8) | cls;
+  }
+
+  size_t num_classes() const { return chunk_sizes_.size(); }
+  uint32_t chunk_size(uint8_t cls) const { return chunk_sizes_[cls]; }
+  // Smallest class whose chunks fit `length` bytes; `length` must fit a page
+  uint8_t class_of(uint32_t length) const {
+    assert(length <= page_size_);
+    return std::lower_bound(chunk_sizes_.begin(), chunk_sizes_.end(),
+                            length) -
+           chunk_sizes_.begin();
+  }
+
+  // Store an item of `length` bytes for `tenant`, replacing the existing one
+  // of the key; return nullptr if it cannot be stored, e.g., it is longer
+  // than a page or every chunk it could take is pinned.
+  Handle_t insert(uint32_t tenant, Key_t key, uint32_t length,
+                  bool pin = false);
+  Handle_t lookup(Key_t key, bool pin = false) {
+    return shared_.lookup(key, pin);
+  }
+  void release(Handle_t handle) { shared_.release(handle); }
+  void pin(Handle_t handle) { shared_.pin(handle); }
+  // Remove the item of a key, freeing its chunk; fail if absent or pinned
+  bool erase(Key_t key);
+
+  // For each tenant, move a page from the class that evicted the fewest items
+  // since the last call to the one that evicted the most, as memcached's slab
+  // automover does; return the number of pages moved.
+  size_t rebalance();
+
+  // Move up to `pages` of src's page quota to dst; src gives back pages over
+  // its new quota at once, from its classes with the most pages, unless they
+  // hold pinned items. Return the number of pages of quota moved.
+  size_t relocate(uint32_t src, uint32_t dst, size_t pages);
+
+  size_t quota_of(uint32_t tenant) const { return get_tenant(tenant).quota; }
+  size_t pages_of(uint32_t tenant) const {
+    return get_tenant(tenant).num_pages;
+  }
+  size_t pages_of(uint32_t tenant, uint8_t cls) const {
+    return get_tenant(tenant).class_pages[cls];
+  }
+  // Number of items of a tenant in a class
+  size_t size_of(uint32_t tenant, uint8_t cls) const {
+    return shared_.size_of(make_tag(tenant, cls));
+  }
+  uint64_t evictions_of(uint32_t tenant, uint8_t cls) const {
+    return get_tenant(tenant).evictions[cls];
+  }
+  const Shared_t& get_shared() const { return shared_; }
+
+ private:
+  using Node_t = LRUNode<Key_t, TaggedValue<uint64_t, SlabItem>>;
+  static constexpr uint32_t kNoPage = std::numeric_limits<uint32_t>::max();
+
+  struct Page {
+    char* data;      // allocated the first time the page is carved
+    Node_t* nodes;   // one handle per chunk; nullptr if not carved
+    uint32_t num_chunks;
+    uint32_t tenant;
+    uint8_t cls;
+  };
+
+  struct Tenant {
+    size_t quota;
+    size_t num_pages;
+    std::vector<size_t> class_pages;
+    std::vector<uint64_t> evictions;  // since the last rebalance
+  };
+
+  Tenant& get_tenant(uint32_t tenant) {
+    assert(tenants_.contains(tenant));
+    return tenants_.find(tenant)->second;
+  }
+  const Tenant& get_tenant(uint32_t tenant) const {
+    assert(tenants_.contains(tenant));
+    return tenants_.find(tenant)->second;
+  }
+
+  // Carve a free page for a tenant's class if the tenant is under its quota
+  bool grow(uint32_t tenant, uint8_t cls);
+  void carve(uint32_t page, uint32_t tenant, uint8_t cls);
+  // Evict a page's items and free it; fail if any is pinned
+  bool reclaim(uint32_t page);
+  // Reclaim a page of a tenant's class, preferably the one holding the least
+  // recently used item
+  bool reclaim_from(uint32_t tenant, uint8_t cls);
+  // Free an item's chunk, keeping it in its class; fail if pinned
+  bool remove(Handle_t handle);
+
+  Shared_t shared_;
+  uint32_t page_size_;
+  std::vector<uint32_t> chunk_sizes_;
+  std::vector<Page> pages_;
+  std::vector<uint32_t> free_pages_;
+  std::unordered_map<uint32_t, Tenant> tenants_;
+  std::pmr::memory_resource* mr_;
+};
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+SlabCache<Key_t, Hash, Mode>::~SlabCache() {
+  // the SharedCache does not own the handles, so it need not retire them
+  std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+  for (auto& page : pages_) {
+    if (page.nodes) {
+      std::destroy_n(page.nodes, page.num_chunks);
+      alloc.deallocate(page.nodes, page.num_chunks);
+    }
+    if (page.data)
+      mr_->deallocate(page.data, page_size_, alignof(std::max_align_t));
+  }
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+void SlabCache<Key_t, Hash, Mode>::init(
+    const std::vector<std::pair<uint32_t, size_t>>& tenant_configs,
+    uint32_t page_size, uint32_t min_chunk, double factor) {
+  assert(!page_size_);
+  assert(min_chunk > 0 && min_chunk <= page_size && factor > 1);
+  page_size_ = page_size;
+  // chunks are 8-byte aligned; the largest class takes a whole page
+  for (double size = min_chunk; size < page_size / 2.0; size *= factor) {
+    uint32_t chunk = (static_cast<uint32_t>(size) + 7) & ~7u;
+    if (chunk_sizes_.empty() || chunk > chunk_sizes_.back())
+      chunk_sizes_.push_back(chunk);
+  }
+  chunk_sizes_.push_back(page_size);
+  assert(chunk_sizes_.size() <= 256);
+
+  size_t num_pages = 0;
+  std::vector<uint64_t> tags;
+  for (auto [tenant, quota] : tenant_configs) {
+    [[maybe_unused]] auto [it, is_emplaced] = tenants_.emplace(
+        tenant, Tenant{quota, 0, std::vector<size_t>(num_classes()),
+                       std::vector<uint64_t>(num_classes())});
+    assert(is_emplaced);
+    num_pages += quota;
+    for (size_t cls = 0; cls < num_classes(); ++cls)
+      tags.push_back(make_tag(tenant, cls));
+  }
+  pages_.assign(num_pages, Page{nullptr, nullptr, 0, 0, 0});
+  // pages are carved in order
+  for (size_t p = num_pages; p > 0; --p) free_pages_.push_back(p - 1);
+  // enough buckets for every page carved into the smallest chunks
+  shared_.init_empty(tags, num_pages * (page_size / chunk_sizes_[0]));
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+typename SlabCache<Key_t, Hash, Mode>::Handle_t
+SlabCache<Key_t, Hash, Mode>::insert(uint32_t tenant, Key_t key,
+                                     uint32_t length, bool pin) {
+  if (length > page_size_) return nullptr;
+  uint8_t cls = class_of(length);
+  uint64_t tag = make_tag(tenant, cls);
+
+  if (Handle_t h = shared_.lookup(key)) {
+    // an item of the same tenant and class keeps its chunk; otherwise, it
+    // moves to a chunk of the new class
+    if (h.get_tag() == tag) {
+      shared_.resize(h, length);
+      if (pin) shared_.pin(h);
+      return h;
+    }
+    if (!remove(h)) return nullptr;
+  } else {
+    shared_.count_miss(tag);
+  }
+
+  if (shared_.size_of(tag) == shared_.capacity_of(tag) && !grow(tenant, cls)) {
+    // a class the tenant can't grow still shows demand, even with no page to
+    // evict from, so rebalance can move a page to it
+    ++get_tenant(tenant).evictions[cls];
+    if (!shared_.capacity_of(tag)) return nullptr;
+  }
+  return shared_.insert_sized(tag, key, length, pin, /*hint_nonexist*/ true);
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+bool SlabCache<Key_t, Hash, Mode>::erase(Key_t key) {
+  Handle_t h = shared_.lookup(key);
+  return h && remove(h);
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+size_t SlabCache<Key_t, Hash, Mode>::rebalance() {
+  size_t moved = 0;
+  for (auto& [tenant, t] : tenants_) {
+    auto most = std::max_element(t.evictions.begin(), t.evictions.end());
+    uint8_t dst = most - t.evictions.begin();
+    if (*most > 0) {
+      // the source must have a page and evict less than the destination
+      uint8_t src = dst;
+      for (size_t cls = 0; cls < num_classes(); ++cls) {
+        if (cls == dst || !t.class_pages[cls]) continue;
+        if (t.evictions[cls] < (src == dst ? *most : t.evictions[src]))
+          src = cls;
+      }
+      if (src != dst && reclaim_from(tenant, src) && grow(tenant, dst))
+        ++moved;
+    }
+    std::fill(t.evictions.begin(), t.evictions.end(), 0);
+  }
+  return moved;
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+size_t SlabCache<Key_t, Hash, Mode>::relocate(uint32_t src, uint32_t dst,
+                                              size_t pages) {
+  Tenant& s = get_tenant(src);
+  Tenant& d = get_tenant(dst);
+  size_t n = std::min(pages, s.quota);
+  s.quota -= n;
+  d.quota += n;
+  while (s.num_pages > s.quota) {
+    // classes by the number of pages, most first
+    std::vector<uint8_t> classes(num_classes());
+    for (size_t cls = 0; cls < num_classes(); ++cls) classes[cls] = cls;
+    std::sort(classes.begin(), classes.end(), [&](uint8_t a, uint8_t b) {
+      return s.class_pages[a] > s.class_pages[b];
+    });
+    bool reclaimed = false;
+    for (uint8_t cls : classes) {
+      if (!s.class_pages[cls]) break;
+      if ((reclaimed = reclaim_from(src, cls))) break;
+    }
+    if (!reclaimed) break;
+  }
+  return n;
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+bool SlabCache<Key_t, Hash, Mode>::grow(uint32_t tenant, uint8_t cls) {
+  Tenant& t = get_tenant(tenant);
+  if (t.num_pages >= t.quota || free_pages_.empty()) return false;
+  uint32_t page = free_pages_.back();
+  free_pages_.pop_back();
+  carve(page, tenant, cls);
+  return true;
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+void SlabCache<Key_t, Hash, Mode>::carve(uint32_t p, uint32_t tenant,
+                                         uint8_t cls) {
+  Page& page = pages_[p];
+  assert(!page.nodes);
+  if (!page.data) {
+    page.data = static_cast<char*>(
+        mr_->allocate(page_size_, alignof(std::max_align_t)));
+  }
+  uint32_t chunk = chunk_sizes_[cls];
+  page.num_chunks = page_size_ / chunk;
+  page.tenant = tenant;
+  page.cls = cls;
+  std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+  page.nodes = alloc.allocate(page.num_chunks);
+  std::uninitialized_default_construct_n(page.nodes, page.num_chunks);
+  uint64_t tag = make_tag(tenant, cls);
+  for (uint32_t i = 0; i < page.num_chunks; ++i) {
+    page.nodes[i].value.value = {page.data + i * chunk, p};
+    shared_.adopt(tag, Handle_t(&page.nodes[i]));
+  }
+  Tenant& t = get_tenant(tenant);
+  ++t.num_pages;
+  ++t.class_pages[cls];
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+bool SlabCache<Key_t, Hash, Mode>::reclaim(uint32_t p) {
+  Page& page = pages_[p];
+  assert(page.nodes);
+  // check all before retiring any, which drops its item
+  for (uint32_t i = 0; i < page.num_chunks; ++i) {
+    if (shared_.is_pinned(Handle_t(&page.nodes[i]))) return false;
+  }
+  for (uint32_t i = 0; i < page.num_chunks; ++i) {
+    [[maybe_unused]] bool is_retired = shared_.retire(Handle_t(&page.nodes[i]));
+    assert(is_retired);
+  }
+  std::pmr::polymorphic_allocator<Node_t> alloc(mr_);
+  std::destroy_n(page.nodes, page.num_chunks);
+  alloc.deallocate(page.nodes, page.num_chunks);
+  page.nodes = nullptr;
+  Tenant& t = get_tenant(page.tenant);
+  --t.num_pages;
+  --t.class_pages[page.cls];
+  free_pages_.push_back(p);
+  return true;
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+bool SlabCache<Key_t, Hash, Mode>::reclaim_from(uint32_t tenant, uint8_t cls) {
+  uint32_t lru_page = kNoPage;
+  shared_.get_cache(make_tag(tenant, cls)).for_each_until_lru([&](auto* e) {
+    lru_page = e->value.value.page;
+    return false;
+  });
+  if (lru_page != kNoPage && reclaim(lru_page)) return true;
+  for (uint32_t p = 0; p < pages_.size(); ++p) {
+    if (p != lru_page && pages_[p].nodes && pages_[p].tenant == tenant &&
+        pages_[p].cls == cls && reclaim(p))
+      return true;
+  }
+  return false;
+}
+
+template <typename Key_t, typename Hash, EvictMode Mode>
+bool SlabCache<Key_t, Hash, Mode>::remove(Handle_t handle) {
+  uint64_t tag = handle.get_tag();
+  if (!shared_.retire(handle, /*is_eviction*/ false)) return false;
+  shared_.adopt(tag, handle);
+  return true;
+}
+
+}  // namespace gcache
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ghost_cache.h"
+#include "reuse_histogram.h"
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * Compute exact LRU stack distances of a key-value cache at full resolution.
+ * Unlike GhostCache, whose histogram is only as fine as `tick`, it counts
+ * accesses at every distance from 1 to max_count, so the miss ratio of any
+ * cache size can be derived from `get_reuse_histogram` after the replay.
+ *
+ * Each key's last access time is marked in a Fenwick tree over logical time;
+ * the stack distance of a reuse is the number of marks after the previous
+ * access, i.e., the number of distinct keys accessed since then. A second
+ * tree holds the key-value size at each mark, so the bytes of the most recent
+ * keys, which a cache of that many keys holds, are exact too. When time
+ * runs out of the tree, the live marks are renumbered from 0, and keys deeper
+ * than max_count in the stack are dropped, since their next access misses at
+ * any size anyway. Each access costs a hash lookup and O(log max_count).
+ *
+ * By default support no sampling; similar to SampledGhostKvCache, setting
+ * SampleShift only tracks keys whose hash has that many leading zeros.
+ */
+template <uint32_t SampleShift = 0,
+          typename Hash = std::hash<std::string_view>>
+class StackDistanceKvCache {
+  const uint32_t tick;
+  const uint32_t min_count;
+  const uint32_t max_count;
+  const uint32_t num_ticks;
+  const uint32_t max_distance;  // max_count in sampled keys
+  const uint32_t capacity;      // logical times in the Fenwick tree
+
+  struct LastAccess {
+    uint32_t time;  // logical time
+    uint32_t kv_size;
+  };
+
+  // key hash -> its last access
+  std::unordered_map<uint64_t, LastAccess> last_access;
+  std::vector<uint32_t> marks;  // Fenwick tree, 1-based
+  std::vector<uint64_t> sizes;  // Fenwick tree of kv_size at each mark
+  uint32_t now;
+
+  std::vector<uint64_t> distances;  // distances[d - 1]: reuses at distance d
+  uint64_t reuse_count;             // count all accesses
+
+  std::vector<CacheStat> caches_stat;
+  uint64_t caches_stat_count;  // reuse_count when caches_stat was built
+
+  void mark(uint32_t t, int32_t delta, int64_t kv_size) {
+    for (uint32_t i = t + 1; i <= capacity; i += i & -i) {
+      marks[i] += delta;
+      sizes[i] += kv_size;
+    }
+  }
+
+  // number of marks at logical times before t
+  [[nodiscard]] uint32_t marks_before(uint32_t t) const {
+    uint32_t n = 0;
+    for (uint32_t i = t; i > 0; i -= i & -i) n += marks[i];
+    return n;
+  }
+
+  // Bytes of the `n` most recently accessed keys
+  [[nodiscard]] uint64_t mru_bytes(uint32_t n) const {
+    uint32_t num_older = last_access.size() > n ? last_access.size() - n : 0;
+    uint64_t total = sizes[capacity];  // capacity is a power of two
+    if (!num_older) return total;
+    // descend to the tree prefix holding exactly `num_older` marks
+    uint32_t i = 0;
+    uint64_t older = 0;
+    for (uint32_t step = capacity; step > 0; step >>= 1) {
+      if (i + step <= capacity && marks[i + step] <= num_older) {
+        i += step;
+        num_older -= marks[i];
+        older += sizes[i];
+        if (!num_older) break;
+      }
+    }
+    return total - older;
+  }
+
+  void compact() {
+    std::vector<std::pair<uint32_t, uint64_t>> live;
+    live.reserve(last_access.size());
+    for (auto& [key, a] : last_access) live.emplace_back(a.time, key);
+    std::sort(live.begin(), live.end());
+    size_t num_dropped =
+        live.size() > max_distance ? live.size() - max_distance : 0;
+    for (size_t i = 0; i < num_dropped; ++i) last_access.erase(live[i].second);
+    now = 0;
+    std::fill(sizes.begin(), sizes.end(), 0);
+    for (size_t i = num_dropped; i < live.size(); ++i) {
+      LastAccess& a = last_access[live[i].second];
+      a.time = now++;
+      sizes[a.time + 1] = a.kv_size;
+    }
+    // times [0, now) are all marked: node i covers (i - lowbit(i), i]; sizes
+    // are summed up the tree in place
+    for (uint32_t i = 1; i <= capacity; ++i) {
+      uint32_t lowbit = i & -i;
+      uint32_t lo = i - lowbit;
+      marks[i] = now > lo ? std::min(now - lo, lowbit) : 0;
+      if (i + lowbit <= capacity) sizes[i + lowbit] += sizes[i];
+    }
+  }
+
+  void build_caches_stat() {
+    if (caches_stat_count == reuse_count) return;
+    caches_stat_count = reuse_count;
+    uint64_t hit_cnt = 0;
+    uint32_t d = 0;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      uint32_t limit = (min_count + idx * tick) >> SampleShift;
+      for (; d < limit; ++d) hit_cnt += distances[d];
+      caches_stat[idx].hit_cnt = hit_cnt;
+      caches_stat[idx].miss_cnt = reuse_count - hit_cnt;
+    }
+  }
+
+ public:
+  StackDistanceKvCache(uint32_t tick, uint32_t min_count, uint32_t max_count)
+      : tick(tick),
+        min_count(min_count),
+        max_count(max_count),
+        num_ticks((max_count - min_count) / tick + 1),
+        max_distance(std::max(max_count >> SampleShift, 1u)),
+        capacity(std::bit_ceil(std::max(4 * max_distance, 4096u))),
+        last_access(),
+        marks(capacity + 1, 0),
+        sizes(capacity + 1, 0),
+        now(0),
+        distances(max_distance, 0),
+        reuse_count(0),
+        caches_stat(num_ticks),
+        caches_stat_count(0) {
+    static_assert(SampleShift <= 32, "SampleShift must be no larger than 32");
+    assert(tick > 0);
+    assert(min_count + (num_ticks - 1) * tick == max_count);
+  }
+
+  void access(const std::string_view key, uint32_t kv_size,
+              AccessMode mode = AccessMode::DEFAULT) {
+    uint64_t full_hash = Hash{}(key);
+    uint32_t key_hash = full_hash;
+    // only with certain number of leading zeros is sampled
+    if constexpr (SampleShift > 0) {
+      if (key_hash >> (32 - SampleShift)) return;
+    }
+    if (now == capacity) compact();
+    auto [it, is_new] = last_access.try_emplace(full_hash, now, kv_size);
+    uint64_t d = 0;  // 0 for the first access of a key
+    if (!is_new) {
+      // marks after the previous access, plus this key's own
+      d = last_access.size() - marks_before(it->second.time + 1) + 1;
+      mark(it->second.time, -1, -int64_t{it->second.kv_size});
+      it->second = {now, kv_size};
+    }
+    mark(now, 1, kv_size);
+    ++now;
+
+    switch (mode) {
+      case AccessMode::DEFAULT:
+        if (d && d <= max_distance) ++distances[d - 1];
+        break;
+      case AccessMode::AS_MISS:
+        break;
+      case AccessMode::AS_HIT:
+        ++distances[0];
+        break;
+      case AccessMode::NOOP:
+        return;
+    }
+    ++reuse_count;
+  }
+
+  [[nodiscard]] uint32_t get_tick() const { return tick; }
+  [[nodiscard]] uint32_t get_min_count() const { return min_count; }
+  [[nodiscard]] uint32_t get_max_count() const { return max_count; }
+  [[nodiscard]] double get_hit_rate(uint32_t count) {
+    return get_stat(count).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t count) {
+    return get_stat(count).get_miss_rate();
+  }
+  [[nodiscard]] const CacheStat& get_stat(uint32_t count) {
+    assert(count >= min_count);
+    assert(count <= max_count);
+    assert((count - min_count) % tick == 0);
+    build_caches_stat();
+    return caches_stat[(count - min_count) / tick];
+  }
+
+  void reset_stat() {
+    reuse_count = 0;
+    caches_stat_count = 0;
+    for (auto& n : distances) n = 0;
+    for (auto& s : caches_stat) s.reset();
+  }
+
+  // Full-resolution histogram: one bucket per stack distance, scaled back to
+  // unsampled keys
+  [[nodiscard]] ReuseHistogram get_reuse_histogram() const {
+    ReuseHistogram h;
+    h.bounds.reserve(max_distance);
+    for (uint32_t d = 1; d <= max_distance; ++d)
+      h.bounds.push_back(d << SampleShift);
+    h.counts.assign(distances.begin(), distances.end());
+    h.total = reuse_count;
+    return h;
+  }
+
+  [[nodiscard]] const std::vector<std::tuple<
+      /*count*/ uint32_t, /*size*/ uint64_t, /*miss_rate*/ CacheStat>>
+  get_cache_stat_curve() {
+    std::vector<std::tuple<uint32_t, uint64_t, CacheStat>> curve;
+    build_caches_stat();
+    // like a ghost cache, only report sizes that the working set could fill;
+    // keys are only dropped beyond max_count, so this is exact up to it
+    uint64_t distinct = last_access.size() << SampleShift;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      uint32_t count = min_count + idx * tick;
+      if (count > distinct) break;
+      curve.emplace_back(count, mru_bytes(count >> SampleShift) << SampleShift,
+                         caches_stat[idx]);
+    }
+    return curve;
+  }
+};
+}  // namespace gcache
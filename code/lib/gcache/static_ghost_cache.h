@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory_resource>
+
+#include "ghost_cache.h"
+#include "hash.h"
+#include "lru_cache.h"
+#include "reuse_histogram.h"
+#include "stat.h"
+
+namespace gcache {
+
+/**
+ * GhostCache with tick, min_size and max_size fixed at compile time, for
+ * configurations known ahead. The boundaries and histograms are std::arrays
+ * sized by the number of ticks, so they live inline with the object, and the
+ * size_idx of a new block is computed with a constant divisor (a shift if
+ * Tick is a power of two) instead of a runtime division.
+ *
+ * It keeps the cumulative stat only; windows and snapshots are left to
+ * GhostCache.
+ */
+template <uint32_t Tick, uint32_t MinSize, uint32_t MaxSize,
+          typename Hash = ghash, typename Meta = GhostMeta>
+class StaticGhostCache {
+  static_assert(Tick > 0);
+  static_assert(MinSize > 1);  // otherwise the first boundary is LRU evicted
+  static_assert(MaxSize > MinSize && (MaxSize - MinSize) % Tick == 0);
+
+ public:
+  static constexpr uint32_t num_ticks = (MaxSize - MinSize) / Tick + 1;
+  static_assert(num_ticks > 2);
+
+  using Handle_t = typename LRUCache<uint32_t, Meta, Hash>::Handle_t;
+  using Node_t = typename LRUCache<uint32_t, Meta, Hash>::Node_t;
+
+ protected:
+  LRUCache<uint32_t, Meta, Hash> cache;
+  std::array<Node_t*, num_ticks - 1> boundaries;
+  std::array<uint64_t, num_ticks> reuse_distances;
+  uint64_t reuse_count;
+  std::array<CacheStat, num_ticks> caches_stat;
+
+  // ceil((size - MinSize) / Tick) for size > MinSize
+  static constexpr uint32_t ticks_above_min(uint32_t size) {
+    if constexpr (std::has_single_bit(Tick)) {
+      return (size - MinSize + Tick - 1) >> std::countr_zero(Tick);
+    } else {
+      return (size - MinSize + Tick - 1) / Tick;
+    }
+  }
+
+  // Same as GhostCache::access_impl
+  Handle_t access_impl(uint32_t block_id, uint32_t hash, AccessMode mode) {
+    Handle_t s;  // successor
+    Handle_t h = cache.refresh(block_id, hash, s);
+    assert(h);  // Since there is no handle in use, allocation must never fail.
+
+    uint32_t size_idx;
+    if (s) {  // No new insertion
+      size_idx = h->size_idx;
+      if (size_idx < num_ticks - 1 && boundaries[size_idx] == h.node)
+        boundaries[size_idx] = s.node;
+    } else {
+      assert(cache.size() <= MaxSize);
+      uint32_t size = cache.size();
+      size_idx = size > MinSize ? ticks_above_min(size) : 0;
+      if (size_idx < num_ticks - 1 && size == size_idx * Tick + MinSize)
+        boundaries[size_idx] = cache.lru_.next;
+    }
+    for (uint32_t i = 0; i < size_idx; ++i) {
+      auto& b = boundaries[i];
+      if (!b) continue;
+      b->value.size_idx++;
+      b = b->next;
+    }
+    h->size_idx = 0;
+
+    switch (mode) {
+      case AccessMode::DEFAULT:
+        // if no successor,it must be a miss for all cache sizes
+        if (s) ++reuse_distances[size_idx];
+        ++reuse_count;
+        break;
+      case AccessMode::AS_MISS:
+        ++reuse_count;
+        break;
+      case AccessMode::AS_HIT:
+        ++reuse_distances[0];
+        ++reuse_count;
+        break;
+      case AccessMode::NOOP:
+        break;
+    }
+    return h;
+  }
+
+  void build_caches_stat() {
+    uint64_t accum_hit_cnt = 0;
+    for (uint32_t idx = 0; idx < num_ticks; ++idx) {
+      accum_hit_cnt += reuse_distances[idx];
+      caches_stat[idx].hit_cnt = accum_hit_cnt;
+      caches_stat[idx].miss_cnt = reuse_count - accum_hit_cnt;
+    }
+  }
+
+ public:
+  // LRU handles and table are allocated from `mr`
+  explicit StaticGhostCache(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : cache(mr), boundaries{}, reuse_distances{}, reuse_count(0) {
+    cache.init(MaxSize);
+  }
+
+  void access(uint32_t block_id, AccessMode mode = AccessMode::DEFAULT) {
+    access_impl(block_id, Hash{}(block_id), mode);
+  }
+
+  [[nodiscard]] static constexpr uint32_t get_tick() { return Tick; }
+  [[nodiscard]] static constexpr uint32_t get_min_size() { return MinSize; }
+  [[nodiscard]] static constexpr uint32_t get_max_size() { return MaxSize; }
+
+  [[nodiscard]] const CacheStat& get_stat(uint32_t cache_size) {
+    assert(cache_size >= MinSize);
+    assert(cache_size <= MaxSize);
+    assert((cache_size - MinSize) % Tick == 0);
+    const CacheStat& stat = caches_stat[(cache_size - MinSize) / Tick];
+    if (stat.hit_cnt + stat.miss_cnt != reuse_count) build_caches_stat();
+    return stat;
+  }
+  [[nodiscard]] double get_hit_rate(uint32_t cache_size) {
+    return get_stat(cache_size).get_hit_rate();
+  }
+  [[nodiscard]] double get_miss_rate(uint32_t cache_size) {
+    return get_stat(cache_size).get_miss_rate();
+  }
+
+  void reset_stat() {
+    reuse_count = 0;
+    reuse_distances.fill(0);
+  }
+
+  // See GhostCache::get_reuse_histogram
+  [[nodiscard]] ReuseHistogram get_reuse_histogram() const {
+    ReuseHistogram h;
+    for (uint32_t i = 0; i < num_ticks; ++i) {
+      h.bounds.push_back(MinSize + i * Tick);
+      h.counts.push_back(reuse_distances[i]);
+    }
+    h.total = reuse_count;
+    return h;
+  }
+
+  // For each item in the LRU list, call fn in LRU order
+  template <typename Fn>
+  void for_each_lru(Fn&& fn) const {
+    cache.for_each_lru([&fn](Handle_t h) { fn(h.get_key()); });
+  }
+
+  // For each item in the LRU list, call fn in MRU order
+  template <typename Fn>
+  void for_each_mru(Fn&& fn) const {
+    cache.for_each_mru([&fn](Handle_t h) { fn(h.get_key()); });
+  }
+};
+}  // namespace gcache
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory_resource>
 
 #include "node.h"
 
@@ -24,8 +25,13 @@ class NodeTable {
   using Node_t = LRUNode<Key_t, Value_t>;
 
  public:
-  NodeTable() : length_(0), list_(nullptr) {}
-  ~NodeTable() { delete[] list_; }
+  // Buckets are allocated from `mr`, which must outlive the table
+  explicit NodeTable(
+      std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : length_(0), list_(nullptr), mr_(mr) {}
+  ~NodeTable() {
+    if (list_) mr_->deallocate(list_, sizeof(list_[0]) * length_);
+  }
 
   void init(size_t size);  // size must be 2^n; must be called before any r/w
 
@@ -33,6 +39,10 @@ class NodeTable {
   void insert(Node_t* e);
   Node_t* lookup(Key_t key, uint32_t hash);
   Node_t* remove(Key_t key, uint32_t hash);
+  // Hint that the bucket of `hash` is about to be accessed, e.g., by `remove`
+  void prefetch(uint32_t hash) const {
+    __builtin_prefetch(&list_[hash & (length_ - 1)]);
+  }
 
  private:
   // Return a pointer to slot that points to a cache entry that
@@ -44,6 +54,7 @@ class NodeTable {
   // a linked list of cache entries that hash into the bucket.
   uint32_t length_;
   Node_t** list_;
+  std::pmr::memory_resource* mr_;
 
  public:  // for debugging
   std::ostream& print(std::ostream& os, int indent = 0) const;
@@ -94,7 +105,7 @@ template <typename Key_t, typename Value_t>
 inline void NodeTable<Key_t, Value_t>::init(size_t size) {
   size = std::bit_ceil<size_t>(size);
   length_ = size;
-  list_ = new Node_t*[length_];
+  list_ = static_cast<Node_t**>(mr_->allocate(sizeof(list_[0]) * length_));
   memset(list_, 0, sizeof(list_[0]) * length_);
 }
 
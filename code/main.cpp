@@ -1,16 +1,34 @@
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#include <unistd.h>
 
 #include <csv.hpp>
+#include <gcache/aet_kv_cache.h>
+#include <gcache/arena.h>
+#include <gcache/counter_stack_kv_cache.h>
 #include <gcache/ghost_kv_cache.h>
+#include <gcache/stack_distance_kv_cache.h>
 
 #include "cache.hpp"
+#include "histogram.hpp"
+#include "memstat.hpp"
+#include "metrics.hpp"
+#include "segment.hpp"
+#include "snapshot.hpp"
+#include "tenant_map.hpp"
+#include "timeseries.hpp"
 #include "trace.hpp"
 
 // Time interval for MRC sampling
@@ -20,14 +38,23 @@
 #define MAX_CACHE (1024)
 #define CACHE_STEP 64
 #define SAMPLE 5
+// Reference cache size of the per-tenant time series
+#define TS_REF_CACHE MIN_CACHE
 
-using mtcache::TraceReq, mtcache::TenantCache;
+using mtcache::TraceReq, mtcache::TenantCache, mtcache::TenantMap,
+    mtcache::TimeSeriesExporter, mtcache::TraceOffsetTracker,
+    mtcache::TraceStream, mtcache::ReplayPosition, mtcache::MappedSnapshot,
+    mtcache::SegmentResult, mtcache::TraceSegment, mtcache::HistogramWriter,
+    mtcache::ReplayMetrics, mtcache::ReplayPhase, mtcache::ScopedPhase;
 using GhostKvCache = gcache::SampledGhostKvCache<0>;
-using ClientsGhostMap = std::unordered_map<uint64_t, TenantCache<GhostKvCache>>;
+using CounterStackKvCache = gcache::CounterStackKvCache<>;
+using AetKvCache = gcache::AetKvCache<>;
+using StackDistanceKvCache = gcache::StackDistanceKvCache<>;
+template <class Cache> using ClientsGhostMap = TenantMap<TenantCache<Cache>>;
 namespace fs = std::filesystem;
 
 void saveMRCToFile(
-    std::vector<std::tuple<uint32_t, uint32_t, gcache::CacheStat>> curve,
+    std::vector<std::tuple<uint32_t, uint64_t, gcache::CacheStat>> curve,
     std::ofstream& outstream) {
     for (auto& point : curve) {
         outstream << std::get<2>(point).get_hit_rate() << std::get<0>(point)
@@ -36,72 +63,228 @@ void saveMRCToFile(
     }
 }
 
+struct ReplayOptions {
+    // Epoch length of the per-tenant time series; disabled if 0
+    uint64_t ts_epoch = 0;
+    // Weight of the history in decayed MRCs at each checkpoint
+    double decay = 0.5;
+    // Allocate all tenant caches from one arena, optionally on huge pages
+    bool arena = false;
+    bool huge_page = false;
+    // Engine name recorded in snapshots
+    std::string engine;
+    // Write a snapshot to `snapshot_path` every `snapshot_interval` rows and
+    // at the end of the trace; disabled if empty
+    std::string snapshot_path;
+    uint64_t snapshot_interval = 1000000;
+    // Resume from the snapshot at `resume_path` if not empty
+    std::string resume_path;
+    // Replay this many time segments of the trace in parallel, each warmed
+    // up with `warm_rows` rows before it; compare with a sequential replay
+    // if `verify`
+    size_t segments = 1;
+    uint64_t warm_rows = 100000;
+    bool verify = false;
+    // Write each tenant's reuse distance histogram at each checkpoint to
+    // `histogram_path` if not empty, log-bucketed with `histogram_bits` bits
+    // of sub-buckets if set
+    std::string histogram_path;
+    std::optional<uint32_t> histogram_bits;
+    // Write throughput metrics as JSON lines to `metrics_path` ("-" for
+    // stderr) every `metrics_interval` if not empty
+    std::string metrics_path;
+    std::chrono::milliseconds metrics_interval{10000};
+};
+
 void usage(std::string& execname) {
-    std::cout << "usage: " << execname << " <tw|fb> <trace>" << std::endl;
+    std::cout << "usage: " << execname
+              << " [-e ghost|cs|aet|sd] [-T epoch] [-d decay] [-A] [-H]"
+              << " [-s snapshot] [-c rows] [-r snapshot] [-P segments]"
+              << " [-w rows] [-V] [-X histograms] [-b bits] [-M metrics]"
+              << " [-m seconds] <tw|fb> <trace>"
+              << std::endl;
     exit(1);
 }
 
-int main(int argc, char* argv[]) {
-    std::string execname(argv[0]);
-    if (argc != 3) {
-        usage(execname);
+template <class Cache>
+int replay(const std::string& trace_path,
+           std::function<TraceReq(csv::CSVRow&)>& parser,
+           const ReplayOptions& options) {
+    if constexpr (!mtcache::SnapshotCache<Cache>) {
+        if (!options.snapshot_path.empty() || !options.resume_path.empty()) {
+            std::cerr << "Engine " << options.engine
+                      << " does not support snapshots" << std::endl;
+            return 1;
+        }
     }
-
-    // Choose parser to use for trace
-    std::string which_trace(argv[1]);
-    std::function<TraceReq(csv::CSVRow&)> parser;
-    if (which_trace == "tw") {
-        parser = TraceReq::fromTwitterLine;
-    } else if (which_trace == "fb") {
-        parser = TraceReq::fromFacebookLine;
-    } else {
-        usage(execname);
+    if constexpr (!mtcache::HistogramCache<Cache>) {
+        if (!options.histogram_path.empty()) {
+            std::cerr << "Engine " << options.engine
+                      << " does not export histograms" << std::endl;
+            return 1;
+        }
     }
-
-    // Open trace and setup CSV parser
-    std::string trace_path(argv[2]);
-    std::ifstream file(trace_path);
-    if (!file.is_open()) {
-        std::cerr << trace_path
-                  << ": could not open file: " << std::strerror(errno)
-                  << std::endl;
-        exit(1);
+    // must be declared before the tenants so it outlives them
+    std::unique_ptr<gcache::Arena> arena;
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+    if (options.arena) {
+        arena = std::make_unique<gcache::Arena>(64 << 20, options.huge_page);
+        mr = arena.get();
     }
-
-    ClientsGhostMap clientsGhostMap;
+    ClientsGhostMap<Cache> clientsGhostMap;
+    std::unique_ptr<TimeSeriesExporter> ts_exporter;
+    if (options.ts_epoch) {
+        ts_exporter = std::make_unique<TimeSeriesExporter>("timeseries.csv",
+                                                           options.ts_epoch);
+    }
+    std::unique_ptr<HistogramWriter> histogram_writer;
+    if (!options.histogram_path.empty()) {
+        try {
+            histogram_writer = std::make_unique<HistogramWriter>(
+                options.histogram_path, options.histogram_bits);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    // attach the per-tenant exports to a tenant seen for the first time
+    auto attach_exports = [&](uint64_t client, TenantCache<Cache>& tenant) {
+        if (ts_exporter) {
+            tenant.attach_time_series(ts_exporter->make_recorder(client),
+                                      TS_REF_CACHE);
+        }
+        if constexpr (mtcache::HistogramCache<Cache>) {
+            if (histogram_writer) {
+                tenant.attach_histogram_writer(histogram_writer.get(), client);
+            }
+        }
+    };
     uint64_t saveTs = 0;
     uint64_t row_number = 1;
-    csv::CSVReader reader(file);
+    csv::CSVFormat format;
+
+    ReplayPosition position{0, row_number, saveTs};
+    if (!options.resume_path.empty()) {
+        if constexpr (mtcache::SnapshotCache<Cache>) {
+            std::unique_ptr<MappedSnapshot> mapped;
+            try {
+                mapped = std::make_unique<MappedSnapshot>(options.resume_path);
+            } catch (const std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+            auto& snapshot = *mapped;
+            if (snapshot.engine() != options.engine) {
+                std::cerr << options.resume_path << ": snapshot of engine "
+                          << snapshot.engine() << std::endl;
+                return 1;
+            }
+            for (auto& entry : snapshot.entries()) {
+                auto tenant_cache =
+                    clientsGhostMap.try_emplace(entry.client, 64, 64, 1024, mr);
+                if (!tenant_cache.first->second.load(snapshot.data(entry),
+                                                     entry.size)) {
+                    std::cerr << options.resume_path
+                              << ": snapshot does not match cache config or is"
+                              << " corrupt" << std::endl;
+                    return 1;
+                }
+                attach_exports(entry.client, tenant_cache.first->second);
+            }
+            position = snapshot.header().position;
+            row_number = position.row_number;
+            saveTs = position.save_ts;
+            std::cout << "Resumed " << clientsGhostMap.size()
+                      << " tenants at row " << row_number << std::endl;
+        }
+        // the header line is before the offset
+        format.no_header();
+    }
+    // lines before the first row after `position.trace_offset`
+    uint64_t header_lines = options.resume_path.empty() ? 1 : 0;
+    TraceOffsetTracker offset_tracker(trace_path, position.trace_offset);
+    auto save_snapshot = [&] {
+        if constexpr (mtcache::SnapshotCache<Cache>) {
+            uint64_t offset = offset_tracker.offset_of_line(
+                header_lines + row_number - position.row_number);
+            mtcache::write_snapshot(options.snapshot_path, options.engine,
+                                    {offset, row_number, saveTs},
+                                    clientsGhostMap);
+            std::cout << "Saved snapshot at row " << row_number << std::endl;
+        }
+    };
+    ReplayMetrics metrics;
+    if (!options.metrics_path.empty()) {
+        try {
+            metrics.open(options.metrics_path, options.metrics_interval);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    auto report_metrics = [&](bool final) {
+        std::vector<std::pair<uint64_t, uint64_t>> tenant_accesses;
+        tenant_accesses.reserve(clientsGhostMap.size());
+        for (auto& kv : clientsGhostMap) {
+            tenant_accesses.emplace_back(kv.first,
+                                         kv.second.get_reqs_processed());
+        }
+        metrics.report(row_number - 1, std::move(tenant_accesses), final);
+    };
+    TraceStream file(trace_path, position.trace_offset);
+    csv::CSVReader reader(file, format);
 
+    // the time to read a row is charged to PARSE, which each row ends in
     for (csv::CSVRow& row : reader) {
         try {
             auto req = parser(row);
+            metrics.count_row(row);
             if (!(row_number % 1000000)) {
-                std::cout << "Processed " << row_number << " requests"
-                          << std::endl;
+                std::cout << "Processed " << row_number << " requests\n";
             }
 
             // Save the MRC curves for each client with a certain time interval
             if (req.timeStamp - saveTs > TIME_DELTA) {
+                ScopedPhase checkpoint(metrics, ReplayPhase::CHECKPOINT);
                 saveTs = (req.timeStamp / TIME_DELTA) * TIME_DELTA;
-                std::cout << "TS " << saveTs << std::endl;
+                std::cout << "TS " << saveTs << "\n";
                 for (auto& kv : clientsGhostMap) {
-                    kv.second.checkpoint_stats(saveTs);
+                    kv.second.checkpoint_stats(saveTs, options.decay);
                 }
             }
 
             // printTraceReq(req);
 
-            auto tenant_cache = clientsGhostMap.try_emplace(
-                req.client, TenantCache<GhostKvCache>(64, 64, 1024));
+            // the cache is only constructed the first time a client is seen
+            metrics.enter(ReplayPhase::DISPATCH);
+            auto tenant_cache =
+                clientsGhostMap.try_emplace(req.client, 64, 64, 1024, mr);
+            if (tenant_cache.second) {
+                attach_exports(req.client, tenant_cache.first->second);
+            }
+            metrics.enter(ReplayPhase::ACCESS);
             tenant_cache.first->second.access(req);
         } catch (const std::runtime_error& e) {
             std::cerr << "Skipped line " << row_number << " in trace ("
                       << e.what() << ")" << std::endl;
         }
+        metrics.enter(ReplayPhase::PARSE);
         row_number++;
+        if (!options.snapshot_path.empty() &&
+            !((row_number - 1) % options.snapshot_interval)) {
+            ScopedPhase snapshot(metrics, ReplayPhase::SNAPSHOT);
+            save_snapshot();
+        }
+        if (metrics.report_due()) {
+            report_metrics(false);
+        }
+    }
+    if (!options.snapshot_path.empty()) {
+        ScopedPhase snapshot(metrics, ReplayPhase::SNAPSHOT);
+        save_snapshot();
     }
 
+    metrics.enter(ReplayPhase::DUMP);
     auto outdir = fs::path("mrc");
     fs::create_directory(outdir);
     for (auto& kv : clientsGhostMap) {
@@ -112,8 +295,300 @@ int main(int argc, char* argv[]) {
         std::ofstream outstream(outpath);
         kv.second.dump_stats(client, outstream);
     }
+    if (ts_exporter) {
+        ts_exporter->stop();
+    }
+    report_metrics(true);
 
-    file.close();
+    std::cout << "Memory: " << mtcache::heap_allocations()
+              << " heap allocations, RSS " << (mtcache::current_rss() >> 20)
+              << " MiB (peak " << (mtcache::peak_rss() >> 20) << " MiB)";
+    if (arena) {
+        std::cout << ", arena " << (arena->allocated() >> 20) << "/"
+                  << (arena->reserved() >> 20) << " MiB in "
+                  << arena->num_chunks() << " chunks";
+    }
+    std::cout << std::endl;
+    clientsGhostMap.clear();
+    arena.reset();
+    std::cout << "Memory: RSS " << (mtcache::current_rss() >> 20)
+              << " MiB after releasing tenant caches" << std::endl;
 
     return 0;
 }
+
+/// Replay one segment of the trace: the warm-up rows only update the caches,
+/// and stats and checkpoints start with the segment's own rows
+template <class Cache>
+SegmentResult replay_segment(const std::string& trace_path,
+                             std::function<TraceReq(csv::CSVRow&)> parser,
+                             const TraceSegment& segment, bool is_first,
+                             const ReplayOptions& options) {
+    std::unique_ptr<gcache::Arena> arena;
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+    if (options.arena) {
+        arena = std::make_unique<gcache::Arena>(64 << 20, options.huge_page);
+        mr = arena.get();
+    }
+    ClientsGhostMap<Cache> clientsGhostMap;
+    SegmentResult result;
+
+    TraceStream file(trace_path, segment.warm_begin);
+    csv::CSVFormat format;
+    format.no_header();
+    csv::CSVReader reader(file, format);
+
+    // Checkpoints are taken whenever the timestamp passes the last one by
+    // TIME_DELTA. A later segment cannot know when the last one before it
+    // was, so it assumes one at its first row; the first checkpoint after
+    // that one coincides with the sequential replay, after which all do.
+    std::optional<uint64_t> saveTs;
+    if (is_first) {
+        saveTs = 0;
+    }
+    uint64_t row_index = 0;
+    uint64_t num_rows = segment.warm_rows + segment.rows;
+    for (csv::CSVRow& row : reader) {
+        if (row_index == num_rows) {
+            break;
+        }
+        bool warming = row_index++ < segment.warm_rows;
+        try {
+            auto req = parser(row);
+            if (!saveTs) {
+                saveTs = (req.timeStamp / TIME_DELTA) * TIME_DELTA;
+            } else if (req.timeStamp - *saveTs > TIME_DELTA) {
+                saveTs = (req.timeStamp / TIME_DELTA) * TIME_DELTA;
+                if (!warming) {
+                    result.checkpoints.push_back(*saveTs);
+                    for (auto& kv : clientsGhostMap) {
+                        kv.second.checkpoint_stats(*saveTs, options.decay);
+                    }
+                }
+            }
+
+            auto tenant_cache =
+                clientsGhostMap.try_emplace(req.client, 64, 64, 1024, mr);
+            if (warming) {
+                tenant_cache.first->second.warm(req);
+            } else {
+                tenant_cache.first->second.access(req);
+            }
+        } catch (const std::runtime_error& e) {
+            // malformed rows are reported by the sequential replay
+        }
+    }
+
+    for (auto& kv : clientsGhostMap) {
+        auto& tenant = result.tenants[kv.first];
+        tenant.first_ts = kv.second.get_first_ts();
+        tenant.last_ts = kv.second.get_last_ts();
+        tenant.curves = kv.second.get_checkpoint_curves();
+        tenant.final_curve = kv.second.get_cache_stat_curve();
+    }
+    return result;
+}
+
+template <class Cache>
+int replay_parallel(const std::string& trace_path,
+                    std::function<TraceReq(csv::CSVRow&)>& parser,
+                    const ReplayOptions& options) {
+    if constexpr (!mtcache::WarmableCache<Cache>) {
+        std::cerr << "Engine " << options.engine
+                  << " does not support warm-up for parallel replay"
+                  << std::endl;
+        return 1;
+    } else {
+        using clock = std::chrono::steady_clock;
+        auto segments = mtcache::split_trace(trace_path, options.segments,
+                                             options.warm_rows);
+        std::cout << "Replaying " << segments.size() << " segments with "
+                  << options.warm_rows << " warm-up rows" << std::endl;
+
+        auto begin = clock::now();
+        std::vector<SegmentResult> results(segments.size());
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            workers.emplace_back([&, i] {
+                results[i] = replay_segment<Cache>(trace_path, parser,
+                                                   segments[i], i == 0,
+                                                   options);
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        auto stitched = mtcache::stitch_segments(results);
+        std::chrono::duration<double> elapsed = clock::now() - begin;
+        std::cout << "Parallel replay: " << elapsed.count() << " s"
+                  << std::endl;
+
+        auto outdir = fs::path("mrc");
+        fs::create_directory(outdir);
+        for (auto& [client, tenant] : stitched) {
+            using json = nlohmann::json;
+            json out_obj;
+            out_obj["first_ts"] = *tenant.first_ts;
+            out_obj["last_ts"] = *tenant.last_ts;
+            out_obj["mrcs"] = json::object();
+            for (auto& [ts, curve] : tenant.curves) {
+                out_obj["mrcs"][std::to_string(ts)] =
+                    mtcache::miss_rate_curve_as_strings(curve);
+            }
+            std::ofstream outstream(outdir / std::to_string(client));
+            outstream << out_obj.dump() << std::endl;
+        }
+
+        if (options.verify) {
+            // the whole trace as a single segment is the sequential replay
+            auto whole = segments.front();
+            whole.end = segments.back().end;
+            whole.rows = 0;
+            for (auto& seg : segments) {
+                whole.rows += seg.rows;
+            }
+            begin = clock::now();
+            auto exact = mtcache::stitch_segments(
+                {replay_segment<Cache>(trace_path, parser, whole, true,
+                                       options)});
+            elapsed = clock::now() - begin;
+            auto d = mtcache::compare_stitched(stitched, exact);
+            std::cout << "Sequential replay: " << elapsed.count() << " s"
+                      << std::endl;
+            std::cout << "Divergence: miss ratio MAE " << d.mean_mae
+                      << " (max " << d.max_mae << ") over " << d.num_curves
+                      << " curves, " << d.num_missing << " curves missing"
+                      << std::endl;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    std::string engine("ghost");
+    ReplayOptions options;
+    int opt;
+    while ((opt = getopt(argc, argv, "e:T:d:AHs:c:r:P:w:VX:b:M:m:")) != -1) {
+        switch (opt) {
+        case 'e':
+            engine = optarg;
+            break;
+        case 'T':
+            options.ts_epoch = std::stoull(optarg);
+            break;
+        case 'd':
+            options.decay = std::stod(optarg);
+            // the weight of the history; 1 would never let it fade
+            if (!(options.decay >= 0 && options.decay < 1)) {
+                std::cerr << "-d must be in [0, 1)" << std::endl;
+                usage(execname);
+            }
+            break;
+        case 'A':
+            options.arena = true;
+            break;
+        case 'H':
+            options.arena = true;
+            options.huge_page = true;
+            break;
+        case 's':
+            options.snapshot_path = optarg;
+            break;
+        case 'c':
+            options.snapshot_interval = std::stoull(optarg);
+            break;
+        case 'r':
+            options.resume_path = optarg;
+            break;
+        case 'P':
+            options.segments = std::stoul(optarg);
+            break;
+        case 'w':
+            options.warm_rows = std::stoull(optarg);
+            break;
+        case 'V':
+            options.verify = true;
+            break;
+        case 'X':
+            options.histogram_path = optarg;
+            break;
+        case 'b':
+            options.histogram_bits = std::stoul(optarg);
+            break;
+        case 'M':
+            options.metrics_path = optarg;
+            break;
+        case 'm':
+            options.metrics_interval = std::chrono::milliseconds(
+                std::llround(std::stod(optarg) * 1000));
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(execname);
+    }
+
+    // Choose parser to use for trace
+    std::string which_trace(argv[optind]);
+    std::function<TraceReq(csv::CSVRow&)> parser;
+    if (which_trace == "tw") {
+        parser = TraceReq::fromTwitterLine;
+    } else if (which_trace == "fb") {
+        parser = TraceReq::fromFacebookLine;
+    } else {
+        usage(execname);
+    }
+
+    // Open trace and setup CSV parser
+    std::string trace_path(argv[optind + 1]);
+    std::ifstream file(trace_path);
+    if (!file.is_open()) {
+        std::cerr << trace_path
+                  << ": could not open file: " << std::strerror(errno)
+                  << std::endl;
+        exit(1);
+    }
+
+    // Choose the MRC engine simulating each tenant
+    options.engine = engine;
+    int ret;
+    if (options.segments > 1 || options.verify) {
+        if (options.ts_epoch || !options.snapshot_path.empty() ||
+            !options.resume_path.empty() || !options.histogram_path.empty() ||
+            !options.metrics_path.empty()) {
+            std::cerr << "-P cannot be combined with -T, -s, -r, -X or -M"
+                      << std::endl;
+            exit(1);
+        }
+        if (engine == "ghost") {
+            ret = replay_parallel<GhostKvCache>(trace_path, parser, options);
+        } else if (engine == "cs") {
+            ret = replay_parallel<CounterStackKvCache>(trace_path, parser,
+                                                       options);
+        } else if (engine == "aet") {
+            ret = replay_parallel<AetKvCache>(trace_path, parser, options);
+        } else if (engine == "sd") {
+            ret = replay_parallel<StackDistanceKvCache>(trace_path, parser,
+                                                        options);
+        } else {
+            usage(execname);
+        }
+    } else if (engine == "ghost") {
+        ret = replay<GhostKvCache>(trace_path, parser, options);
+    } else if (engine == "cs") {
+        ret = replay<CounterStackKvCache>(trace_path, parser, options);
+    } else if (engine == "aet") {
+        ret = replay<AetKvCache>(trace_path, parser, options);
+    } else if (engine == "sd") {
+        ret = replay<StackDistanceKvCache>(trace_path, parser, options);
+    } else {
+        usage(execname);
+    }
+
+    file.close();
+
+    return ret;
+}
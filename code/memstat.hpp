@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mtcache {
+
+/// Number of allocations made through the global operator new so far
+uint64_t heap_allocations();
+
+/// Current resident set size in bytes
+size_t current_rss();
+
+/// Peak resident set size in bytes
+size_t peak_rss();
+
+} // namespace mtcache
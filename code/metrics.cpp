@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+#include "memstat.hpp"
+#include "metrics.hpp"
+
+namespace mtcache {
+
+namespace {
+const char* phase_names[] = {"parse",      "dispatch", "access",
+                             "checkpoint", "snapshot", "dump"};
+static_assert(std::size(phase_names) ==
+              static_cast<size_t>(ReplayPhase::NUM_PHASES));
+} // namespace
+
+void ReplayMetrics::open(const std::string& path,
+                         std::chrono::milliseconds interval) {
+    if (path == "-") {
+        out = &std::cerr;
+    } else {
+        file.open(path);
+        if (!file.is_open()) {
+            throw std::runtime_error(path + ": could not open file");
+        }
+        out = &file;
+    }
+    this->interval = interval;
+    start = last_report = clock::now();
+    start_cycles = phase_begin = read_cycles();
+}
+
+void ReplayMetrics::report(
+    uint64_t row_number,
+    std::vector<std::pair<uint64_t, uint64_t>> tenant_accesses, bool final) {
+    if (!out) {
+        return;
+    }
+    using json = nlohmann::json;
+    // charge the current phase up to now without leaving it
+    enter(phase);
+    auto now = clock::now();
+    double elapsed = std::chrono::duration<double>(now - start).count();
+    double since_last = std::chrono::duration<double>(now - last_report).count();
+    // calibrate the cycle counter against the steady clock over the whole run
+    double cycles_per_s = elapsed > 0 ? (phase_begin - start_cycles) / elapsed
+                                      : 1;
+
+    json obj;
+    obj["row"] = row_number;
+    obj["elapsed_s"] = elapsed;
+    obj["rows"] = rows;
+    obj["bytes"] = bytes;
+    obj["rows_per_s"] = since_last > 0 ? (rows - last_rows) / since_last : 0;
+    obj["bytes_per_s"] = since_last > 0 ? (bytes - last_bytes) / since_last : 0;
+    obj["avg_rows_per_s"] = elapsed > 0 ? rows / elapsed : 0;
+    obj["phase_s"] = json::object();
+    for (size_t i = 0; i < cycles.size(); ++i) {
+        obj["phase_s"][phase_names[i]] = cycles[i] / cycles_per_s;
+    }
+    obj["rss_bytes"] = current_rss();
+    obj["peak_rss_bytes"] = peak_rss();
+    obj["tenants"] = tenant_accesses.size();
+    size_t top = std::min(kTopTenants, tenant_accesses.size());
+    std::partial_sort(
+        tenant_accesses.begin(), tenant_accesses.begin() + top,
+        tenant_accesses.end(),
+        [](auto& a, auto& b) { return a.second > b.second; });
+    obj["top_tenants"] = json::array();
+    for (size_t i = 0; i < top; ++i) {
+        obj["top_tenants"].push_back({{"client", tenant_accesses[i].first},
+                                      {"accesses", tenant_accesses[i].second}});
+    }
+    obj["final"] = final;
+    *out << obj.dump() << '\n' << std::flush;
+
+    last_report = now;
+    last_rows = rows;
+    last_bytes = bytes;
+}
+} // namespace mtcache
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "csv.hpp"
+
+namespace mtcache {
+
+/// Cycle counter for timing phases a few rows long: the TSC on x86, which
+/// costs a few ns to read and ticks at a constant rate on any recent CPU;
+/// the steady clock in ns elsewhere
+inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/// Where a replay spends its time
+enum class ReplayPhase {
+    PARSE,      // reading and parsing trace rows
+    DISPATCH,   // finding or creating the tenant of a row
+    ACCESS,     // the engine's access
+    CHECKPOINT, // assembling the curves of all tenants at a checkpoint
+    SNAPSHOT,   // writing snapshots
+    DUMP,       // writing the curves at the end
+    NUM_PHASES
+};
+
+/// Throughput of a replay and the time it spends in each phase, written as
+/// one JSON object per line every `interval` and once at the end.
+///
+/// The replay is always in exactly one phase; `enter` charges the cycles
+/// since the previous switch to the phase being left, so the phases add up
+/// to the wall time with one cycle counter read per switch. Disabled until
+/// `open`, when every call is a branch on a null pointer.
+class ReplayMetrics {
+  private:
+    using clock = std::chrono::steady_clock;
+    static constexpr size_t kTopTenants = 10;
+
+    std::ofstream file;
+    std::ostream* out = nullptr;
+    clock::duration interval{};
+    std::array<uint64_t, static_cast<size_t>(ReplayPhase::NUM_PHASES)>
+        cycles{};
+    ReplayPhase phase = ReplayPhase::PARSE;
+    uint64_t phase_begin = 0;
+    uint64_t rows = 0;
+    uint64_t bytes = 0;
+    clock::time_point start;
+    uint64_t start_cycles = 0;
+    // as of the previous report
+    clock::time_point last_report;
+    uint64_t last_rows = 0;
+    uint64_t last_bytes = 0;
+
+  public:
+    /// Start measuring, writing reports to `path`, or to stderr if "-"
+    void open(const std::string& path, std::chrono::milliseconds interval);
+
+    bool enabled() const { return out; }
+
+    /// Switch to phase `p`, and return the phase left
+    ReplayPhase enter(ReplayPhase p) {
+        if (!out) {
+            return p;
+        }
+        uint64_t now = read_cycles();
+        cycles[static_cast<size_t>(phase)] += now - phase_begin;
+        phase_begin = now;
+        return std::exchange(phase, p);
+    }
+
+    /// Count a parsed trace row and its bytes, as delimited fields; rows that
+    /// fail to parse may have bogus fields, so they are not counted
+    void count_row(csv::CSVRow& row) {
+        if (!out) {
+            return;
+        }
+        rows++;
+        // by index, as the row iterator allocates for each field
+        for (size_t i = 0; i < row.size(); ++i) {
+            bytes += row[i].get_sv().size() + 1;
+        }
+    }
+
+    /// Whether a report is due; the clock is only read every 1024 rows
+    bool report_due() const {
+        return out && !(rows & 1023) && clock::now() - last_report >= interval;
+    }
+
+    /// Write a report at trace row `row_number`, with the number of accesses
+    /// of each tenant so far; only the busiest ones are listed
+    void report(uint64_t row_number,
+                std::vector<std::pair<uint64_t, uint64_t>> tenant_accesses,
+                bool final = false);
+};
+
+/// Charge the time until the end of the scope to phase `p`, then switch back
+/// to the phase before
+class ScopedPhase {
+  private:
+    ReplayMetrics& metrics;
+    ReplayPhase prev;
+
+  public:
+    ScopedPhase(ReplayMetrics& metrics, ReplayPhase p)
+        : metrics(metrics), prev(metrics.enter(p)) {}
+    ~ScopedPhase() { metrics.enter(prev); }
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+};
+} // namespace mtcache
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "segment.hpp"
+
+namespace mtcache {
+
+namespace {
+
+/// Offset of the first line beginning at or after `offset`
+uint64_t next_line(std::ifstream& file, uint64_t offset) {
+    if (offset == 0) {
+        return 0;
+    }
+    file.clear();
+    file.seekg(offset - 1);
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    return offset - 1 + file.gcount();
+}
+
+/// Offset of the beginning of the line `n` lines before the one at `offset`,
+/// but not before `limit`; `n` is decreased by the lines actually skipped
+uint64_t prev_lines(std::ifstream& file, uint64_t offset, uint64_t limit,
+                    uint64_t& n) {
+    constexpr uint64_t chunk_size = 1 << 16;
+    std::vector<char> chunk(chunk_size);
+    uint64_t wanted = n;
+    n = 0;
+    uint64_t pos = offset;
+    // the newline right before `offset` ends the previous line, which is the
+    // first one to skip
+    while (pos > limit && n < wanted) {
+        uint64_t len = std::min(chunk_size, pos - limit);
+        file.clear();
+        file.seekg(pos - len);
+        file.read(chunk.data(), len);
+        for (uint64_t i = len; i-- > 0;) {
+            // a newline at pos - len + i ends the line before the current one
+            if (chunk[i] == '\n' && pos - len + i + 1 < offset) {
+                if (++n == wanted) {
+                    return pos - len + i + 1;
+                }
+            }
+        }
+        pos -= len;
+    }
+    // reached `limit`, which begins a line
+    if (offset > limit && n < wanted) {
+        ++n;
+    }
+    return limit;
+}
+
+uint64_t count_lines(std::ifstream& file, uint64_t begin, uint64_t end) {
+    constexpr uint64_t chunk_size = 1 << 16;
+    std::vector<char> chunk(chunk_size);
+    uint64_t n = 0;
+    file.clear();
+    file.seekg(begin);
+    for (uint64_t pos = begin; pos < end;) {
+        uint64_t len = std::min(chunk_size, end - pos);
+        file.read(chunk.data(), len);
+        n += std::count(chunk.begin(), chunk.begin() + len, '\n');
+        pos += len;
+    }
+    // the last line may not end with a newline
+    if (end > begin) {
+        file.clear();
+        file.seekg(end - 1);
+        if (file.get() != '\n') {
+            ++n;
+        }
+    }
+    return n;
+}
+
+/// Stat of the last point at or below `count`; a ghost cache that is not full
+/// has no points past its size, but has no hits at those sizes either
+gcache::CacheStat stat_at(const MissRateCurve& curve, uint32_t count) {
+    gcache::CacheStat stat;
+    for (auto& [c, size, s] : curve) {
+        if (c > count) {
+            break;
+        }
+        stat = s;
+    }
+    return stat;
+}
+
+/// Add up the stats of two curves over the union of their points; sizes come
+/// from `curve` where it has the point, since it is the more recent one
+MissRateCurve add_curves(const MissRateCurve& curve, const MissRateCurve& base) {
+    MissRateCurve sum;
+    auto it = curve.begin();
+    auto base_it = base.begin();
+    while (it != curve.end() || base_it != base.end()) {
+        uint32_t count;
+        uint64_t size;
+        if (base_it == base.end() ||
+            (it != curve.end() && std::get<0>(*it) <= std::get<0>(*base_it))) {
+            count = std::get<0>(*it);
+            size = std::get<1>(*it);
+            if (base_it != base.end() && std::get<0>(*base_it) == count) {
+                ++base_it;
+            }
+            ++it;
+        } else {
+            count = std::get<0>(*base_it);
+            size = std::get<1>(*base_it);
+            ++base_it;
+        }
+        auto stat = stat_at(curve, count);
+        auto base_stat = stat_at(base, count);
+        stat.hit_cnt += base_stat.hit_cnt;
+        stat.miss_cnt += base_stat.miss_cnt;
+        sum.emplace_back(count, size, stat);
+    }
+    return sum;
+}
+
+} // namespace
+
+std::vector<TraceSegment> split_trace(const std::string& path, size_t k,
+                                      uint64_t warm_rows) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t size = file.tellg();
+    // skip the header line
+    uint64_t data_begin = next_line(file, 1);
+
+    std::vector<uint64_t> bounds{data_begin};
+    for (size_t i = 1; i < k; ++i) {
+        uint64_t b = next_line(file, data_begin + (size - data_begin) * i / k);
+        bounds.push_back(std::max(b, bounds.back()));
+    }
+    bounds.push_back(size);
+
+    std::vector<TraceSegment> segments;
+    for (size_t i = 0; i < k; ++i) {
+        if (bounds[i] == bounds[i + 1]) {
+            continue; // fewer lines than segments
+        }
+        TraceSegment seg{bounds[i], bounds[i], bounds[i + 1], 0, 0};
+        if (i > 0) {
+            seg.warm_rows = warm_rows;
+            seg.warm_begin =
+                prev_lines(file, seg.begin, data_begin, seg.warm_rows);
+        }
+        seg.rows = count_lines(file, seg.begin, seg.end);
+        segments.push_back(seg);
+    }
+    return segments;
+}
+
+std::map<uint64_t, StitchedTenant>
+stitch_segments(const std::vector<SegmentResult>& segments) {
+    std::map<uint64_t, StitchedTenant> stitched;
+    for (auto& seg : segments) {
+        // stats at the end of the earlier segments
+        std::map<uint64_t, MissRateCurve> base;
+        for (auto& [client, tenant] : stitched) {
+            base.emplace(client, tenant.final_curve);
+        }
+        static const MissRateCurve empty_curve;
+        auto base_of = [&](uint64_t client) -> const MissRateCurve& {
+            auto it = base.find(client);
+            return it == base.end() ? empty_curve : it->second;
+        };
+
+        for (uint64_t ts : seg.checkpoints) {
+            for (auto& [client, curve] : base) {
+                auto it = seg.tenants.find(client);
+                if (it == seg.tenants.end() || !it->second.curves.contains(ts)) {
+                    stitched[client].curves[ts] = curve;
+                }
+            }
+            for (auto& [client, tenant] : seg.tenants) {
+                auto it = tenant.curves.find(ts);
+                if (it != tenant.curves.end()) {
+                    stitched[client].curves[ts] =
+                        add_curves(it->second, base_of(client));
+                }
+            }
+        }
+
+        for (auto& [client, tenant] : seg.tenants) {
+            auto& s = stitched[client];
+            s.final_curve = add_curves(tenant.final_curve, base_of(client));
+            if (!s.first_ts) {
+                s.first_ts = tenant.first_ts;
+            }
+            if (tenant.last_ts) {
+                s.last_ts = tenant.last_ts;
+            }
+        }
+    }
+    return stitched;
+}
+
+Divergence compare_stitched(const std::map<uint64_t, StitchedTenant>& approx,
+                            const std::map<uint64_t, StitchedTenant>& exact) {
+    Divergence d;
+    double mae_sum = 0;
+    for (auto& [client, tenant] : exact) {
+        auto approx_it = approx.find(client);
+        for (auto& [ts, curve] : tenant.curves) {
+            if (approx_it == approx.end() ||
+                !approx_it->second.curves.contains(ts)) {
+                ++d.num_missing;
+                continue;
+            }
+            auto& approx_curve = approx_it->second.curves.at(ts);
+            double err_sum = 0;
+            size_t n = 0;
+            for (auto& [count, size, stat] : curve) {
+                if (stat.hit_cnt + stat.miss_cnt == 0) {
+                    continue;
+                }
+                auto approx_stat = stat_at(approx_curve, count);
+                if (approx_stat.hit_cnt + approx_stat.miss_cnt == 0) {
+                    continue;
+                }
+                err_sum += std::abs(stat.get_miss_rate() -
+                                    approx_stat.get_miss_rate());
+                ++n;
+            }
+            if (n == 0) {
+                continue;
+            }
+            double mae = err_sum / n;
+            mae_sum += mae;
+            d.max_mae = std::max(d.max_mae, mae);
+            ++d.num_curves;
+        }
+    }
+    if (d.num_curves) {
+        d.mean_mae = mae_sum / d.num_curves;
+    }
+    return d;
+}
+
+} // namespace mtcache
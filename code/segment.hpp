@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+
+namespace mtcache {
+
+/// Byte range of one segment of a trace, and of the warm-up rows before it
+struct TraceSegment {
+    uint64_t warm_begin; // offset of the first warm-up row
+    uint64_t begin;      // offset of the first row of the segment
+    uint64_t end;        // offset past the last row of the segment
+    uint64_t warm_rows;  // number of rows in [warm_begin, begin)
+    uint64_t rows;       // number of rows in [begin, end)
+};
+
+/// Split the rows of a trace (after its header line) into `k` segments of
+/// about the same number of bytes at line boundaries. Each segment but the
+/// first is preceded by up to `warm_rows` rows from the end of the previous
+/// one. Assumes each row is one line, and that rows are sorted by time.
+std::vector<TraceSegment> split_trace(const std::string& path, size_t k,
+                                      uint64_t warm_rows);
+
+/// What one segment's replay leaves for stitching
+struct SegmentTenant {
+    std::optional<uint64_t> first_ts;
+    std::optional<uint64_t> last_ts;
+    // curves at each checkpoint; stats only count this segment's accesses
+    std::map<uint64_t, MissRateCurve> curves;
+    // curve at the end of the segment
+    MissRateCurve final_curve;
+};
+
+struct SegmentResult {
+    std::vector<uint64_t> checkpoints;
+    std::map<uint64_t, SegmentTenant> tenants;
+};
+
+/// Per-tenant curves of a whole trace
+struct StitchedTenant {
+    std::optional<uint64_t> first_ts;
+    std::optional<uint64_t> last_ts;
+    std::map<uint64_t, MissRateCurve> curves;
+    // cumulative curve at the end of the last stitched segment
+    MissRateCurve final_curve;
+};
+
+/// Stitch consecutive segments into curves of the whole trace: a checkpoint's
+/// stats are its segment's stats plus the final stats of all earlier
+/// segments, and a tenant not yet seen in a segment keeps its curve from the
+/// end of the earlier ones, as it would in a sequential replay.
+std::map<uint64_t, StitchedTenant>
+stitch_segments(const std::vector<SegmentResult>& segments);
+
+/// Divergence of stitched curves from the exact ones
+struct Divergence {
+    size_t num_curves = 0;  // checkpoint curves compared
+    size_t num_missing = 0; // exact checkpoint curves without a stitched one
+    double mean_mae = 0;    // mean over curves of the miss ratio MAE
+    double max_mae = 0;
+};
+
+Divergence compare_stitched(const std::map<uint64_t, StitchedTenant>& approx,
+                            const std::map<uint64_t, StitchedTenant>& exact);
+
+} // namespace mtcache
@@ -0,0 +1,64 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.hpp"
+
+namespace mtcache {
+
+MappedSnapshot::MappedSnapshot(const std::string& path)
+    : base(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(path + ": could not open file: " +
+                                 std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error(path + ": could not stat file");
+    }
+    length = st.st_size;
+    if (length < sizeof(SnapshotFileHeader)) {
+        close(fd);
+        throw std::runtime_error(path + ": not a snapshot");
+    }
+    base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        throw std::runtime_error(path + ": could not map file");
+    }
+    // tenants are restored in order, so let the kernel read ahead
+    madvise(base, length, MADV_SEQUENTIAL);
+
+    auto& h = header();
+    // compared by division so a corrupt count cannot overflow
+    if (std::memcmp(h.magic, SnapshotFileHeader::kMagic, sizeof(h.magic)) ||
+        h.num_tenants >
+            (length - sizeof(SnapshotFileHeader)) / sizeof(SnapshotEntry)) {
+        munmap(base, length);
+        base = nullptr;
+        throw std::runtime_error(path + ": not a snapshot");
+    }
+    for (auto& entry : entries()) {
+        if (entry.offset > length || entry.size > length - entry.offset) {
+            munmap(base, length);
+            base = nullptr;
+            throw std::runtime_error(path + ": truncated snapshot");
+        }
+    }
+}
+
+MappedSnapshot::~MappedSnapshot() {
+    if (base) {
+        munmap(base, length);
+    }
+}
+
+} // namespace mtcache
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mtcache {
+
+/// Appends plain-old-data to a snapshot buffer. Without a buffer it only
+/// counts bytes, so the same code can compute a snapshot's size and write it.
+class SnapshotWriter {
+  private:
+    char* buf;
+    size_t pos;
+
+  public:
+    explicit SnapshotWriter(char* buf = nullptr) : buf(buf), pos(0) {}
+
+    template <class T> void put(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (buf) {
+            std::memcpy(buf + pos, &v, sizeof(T));
+        }
+        pos += sizeof(T);
+    }
+
+    char* cur() const { return buf + pos; }
+    size_t size() const { return pos; }
+};
+
+/// Reads back what a SnapshotWriter wrote, from a buffer of `len` bytes.
+/// Reading past the end yields zeros and marks the reader as failed.
+class SnapshotReader {
+  private:
+    const char* p;
+    size_t left;
+    bool failed;
+
+  public:
+    SnapshotReader(const char* p, size_t len)
+        : p(p), left(len), failed(false) {}
+
+    template <class T> T get() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T v{};
+        if (!has(sizeof(T))) {
+            failed = true;
+            return v;
+        }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        left -= sizeof(T);
+        return v;
+    }
+
+    /// Whether `n` more bytes can be read
+    bool has(uint64_t n) const { return n <= left; }
+    bool ok() const { return !failed; }
+    const char* cur() const { return p; }
+    size_t remaining() const { return left; }
+};
+
+/// Where a replay was when a snapshot was taken
+struct ReplayPosition {
+    uint64_t trace_offset; // byte offset of the next row in the trace
+    uint64_t row_number;   // number of the next row
+    uint64_t save_ts;      // timestamp of the last checkpoint
+};
+
+/// A snapshot file starts with this header, followed by `num_tenants`
+/// SnapshotEntry and then each tenant's state at 8-byte aligned offsets.
+struct SnapshotFileHeader {
+    static constexpr char kMagic[8] = {'M', 'T', 'C', 'S', 'N', 'A', 'P', '2'};
+
+    char magic[8];
+    char engine[16]; // engine name, NUL-padded
+    ReplayPosition position;
+    uint64_t num_tenants;
+};
+
+struct SnapshotEntry {
+    uint64_t client;
+    uint64_t offset; // from the beginning of the file
+    uint64_t size;
+};
+
+/// Write the state of every tenant in `tenants` (a TenantMap) to `path`. The
+/// file is written next to `path` and renamed over it once complete, so a
+/// crash while writing keeps the previous snapshot intact.
+template <class Map>
+void write_snapshot(const std::string& path, const std::string& engine,
+                    const ReplayPosition& position, const Map& tenants) {
+    SnapshotFileHeader header{};
+    std::memcpy(header.magic, SnapshotFileHeader::kMagic, sizeof(header.magic));
+    if (engine.size() >= sizeof(header.engine)) {
+        throw std::runtime_error(engine + ": engine name too long");
+    }
+    std::memcpy(header.engine, engine.data(), engine.size());
+    header.position = position;
+
+    std::vector<SnapshotEntry> entries;
+    uint64_t offset = 0;
+    for (auto& kv : tenants) {
+        uint64_t size = kv.second.snapshot_size();
+        entries.push_back({kv.first, offset, size});
+        offset += (size + 7) & ~uint64_t{7};
+    }
+    header.num_tenants = entries.size();
+    uint64_t data_begin =
+        sizeof(header) + entries.size() * sizeof(SnapshotEntry);
+    for (auto& entry : entries) {
+        entry.offset += data_begin;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error(tmp_path + ": could not open file");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              entries.size() * sizeof(SnapshotEntry));
+    std::vector<uint64_t> buf; // uint64_t for alignment
+    auto entry = entries.begin();
+    for (auto& kv : tenants) {
+        buf.assign((entry->size + 7) / 8, 0);
+        kv.second.save(reinterpret_cast<char*>(buf.data()));
+        out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * 8);
+        ++entry;
+    }
+    out.close();
+    if (!out) {
+        throw std::runtime_error(tmp_path + ": could not write snapshot");
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+/// A snapshot file mapped read-only; tenants are restored straight from the
+/// mapping without parsing the file into intermediate buffers.
+class MappedSnapshot {
+  private:
+    void* base;
+    size_t length;
+
+  public:
+    explicit MappedSnapshot(const std::string& path);
+    ~MappedSnapshot();
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    const SnapshotFileHeader& header() const {
+        return *static_cast<const SnapshotFileHeader*>(base);
+    }
+    std::string engine() const {
+        return std::string(header().engine,
+                           strnlen(header().engine, sizeof(header().engine)));
+    }
+    std::span<const SnapshotEntry> entries() const {
+        return {reinterpret_cast<const SnapshotEntry*>(&header() + 1),
+                header().num_tenants};
+    }
+    const char* data(const SnapshotEntry& entry) const {
+        return static_cast<const char*>(base) + entry.offset;
+    }
+};
+
+} // namespace mtcache
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mtcache {
+
+/// Directory from a client id to its per-tenant state, specialized for the
+/// replay loop: it is looked up once per request but only grows when a new
+/// client shows up.
+///
+/// The index is a flat open-addressing table (linear probing) of 12-byte
+/// slots, so a lookup touches one or two cache lines instead of chasing a
+/// bucket list. Values live in a deque, so their addresses stay stable and
+/// iteration is in first-seen order. Consecutive requests from the same client
+/// skip the table entirely.
+template <class V> class TenantMap {
+  public:
+    using value_type = std::pair<const uint64_t, V>;
+
+  private:
+    static constexpr uint32_t empty_idx = std::numeric_limits<uint32_t>::max();
+
+#pragma pack(push, 4)
+    struct Slot {
+        uint64_t key;
+        uint32_t idx; // into entries; empty_idx if the slot is free
+    };
+#pragma pack(pop)
+
+    std::vector<Slot> slots;
+    uint32_t shift; // 64 - log2(slots.size())
+    std::deque<value_type> entries;
+
+    // last tenant looked up
+    uint64_t last_key;
+    value_type* last_entry;
+
+    static uint64_t mix(uint64_t key) {
+        // Fibonacci hashing; the high bits are used as the slot index
+        return key * 0x9e3779b97f4a7c15ULL;
+    }
+
+    void grow() {
+        std::vector<Slot> old_slots(slots.size() * 2, Slot{0, empty_idx});
+        old_slots.swap(slots);
+        --shift;
+        for (auto& slot : old_slots) {
+            if (slot.idx != empty_idx) {
+                slots[probe(slot.key)] = slot;
+            }
+        }
+    }
+
+    /// Index of the slot holding `key`, or of the empty slot to insert it
+    size_t probe(uint64_t key) const {
+        size_t mask = slots.size() - 1;
+        size_t i = mix(key) >> shift;
+        while (slots[i].idx != empty_idx && slots[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+  public:
+    explicit TenantMap(size_t capacity = 1024)
+        : slots(std::bit_ceil(std::max<size_t>(capacity * 2, 2)),
+                Slot{0, empty_idx}),
+          shift(64 - std::countr_zero(slots.size())), last_key(0),
+          last_entry(nullptr) {}
+
+    TenantMap(const TenantMap&) = delete;
+    TenantMap& operator=(const TenantMap&) = delete;
+
+    /// Same as std::unordered_map::try_emplace: `args` are only used to
+    /// construct the value in place if `key` is not present yet.
+    template <class... Args>
+    std::pair<value_type*, bool> try_emplace(uint64_t key, Args&&... args) {
+        if (last_entry && last_key == key) [[likely]] {
+            return {last_entry, false};
+        }
+        size_t i = probe(key);
+        uint32_t idx = slots[i].idx;
+        bool is_new = idx == empty_idx;
+        if (is_new) {
+            entries.emplace_back(std::piecewise_construct,
+                                 std::forward_as_tuple(key),
+                                 std::forward_as_tuple(
+                                     std::forward<Args>(args)...));
+            idx = static_cast<uint32_t>(entries.size() - 1);
+            slots[i] = {key, idx};
+            // keep the load factor no larger than 1/2; growing moves slots,
+            // but not entries, so `idx` stays valid
+            if (entries.size() * 2 > slots.size()) {
+                grow();
+            }
+        }
+        last_key = key;
+        last_entry = &entries[idx];
+        return {last_entry, is_new};
+    }
+
+    value_type* find(uint64_t key) {
+        size_t i = probe(key);
+        return slots[i].idx == empty_idx ? nullptr : &entries[slots[i].idx];
+    }
+
+    size_t size() const { return entries.size(); }
+
+    void clear() {
+        entries.clear();
+        std::fill(slots.begin(), slots.end(), Slot{0, empty_idx});
+        last_entry = nullptr;
+    }
+
+    auto begin() { return entries.begin(); }
+    auto end() { return entries.end(); }
+    auto begin() const { return entries.begin(); }
+    auto end() const { return entries.end(); }
+};
+
+} // namespace mtcache
@@ -0,0 +1,88 @@
+#include <bit>
+#include <stdexcept>
+
+#include "timeseries.hpp"
+
+namespace mtcache {
+
+TimeSeriesRing::TimeSeriesRing(size_t capacity)
+    : buf(new TimeSeriesPoint[std::bit_ceil(capacity)]),
+      mask(std::bit_ceil(capacity) - 1), head(0), tail(0) {}
+
+TimeSeriesExporter::TimeSeriesExporter(const std::string& path,
+                                       uint64_t epoch_len, size_t ring_capacity,
+                                       std::chrono::milliseconds period)
+    : out(path), epoch_len(epoch_len), ring_capacity(ring_capacity),
+      period(period), stopping(false) {
+    if (!out.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    out << "client,epoch,hits,misses,bytes\n";
+    worker = std::thread(&TimeSeriesExporter::run, this);
+}
+
+TimeSeriesExporter::~TimeSeriesExporter() { stop(); }
+
+TimeSeriesRecorder* TimeSeriesExporter::make_recorder(uint64_t client) {
+    std::lock_guard<std::mutex> lock(mtx);
+    recorders.push_back(
+        std::make_unique<TimeSeriesRecorder>(client, epoch_len, ring_capacity));
+    return recorders.back().get();
+}
+
+void TimeSeriesExporter::export_all(
+    const std::vector<TimeSeriesRecorder*>& snapshot) {
+    for (auto* r : snapshot) {
+        r->ring.drain([&](const TimeSeriesPoint& p) {
+            out << r->client << ',' << p.epoch << ',' << p.hits << ','
+                << p.misses << ',' << p.bytes << '\n';
+        });
+    }
+}
+
+void TimeSeriesExporter::run() {
+    std::vector<TimeSeriesRecorder*> snapshot;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        cv.wait_for(lock, period, [this] { return stopping; });
+        // recorders are only appended, so a snapshot of the pointers stays
+        // valid after the lock is released
+        snapshot.clear();
+        for (auto& r : recorders) {
+            snapshot.push_back(r.get());
+        }
+        lock.unlock();
+        export_all(snapshot);
+        lock.lock();
+    }
+}
+
+void TimeSeriesExporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+
+    // the worker may have exited between the last publish and its last drain;
+    // a backlog is newer than its ring
+    std::vector<TimeSeriesRecorder*> snapshot;
+    for (auto& r : recorders) {
+        snapshot.push_back(r.get());
+    }
+    export_all(snapshot);
+    for (auto* r : snapshot) {
+        for (size_t i = r->backlog_head; i < r->backlog.size(); ++i) {
+            const TimeSeriesPoint& p = r->backlog[i];
+            out << r->client << ',' << p.epoch << ',' << p.hits << ','
+                << p.misses << ',' << p.bytes << '\n';
+        }
+    }
+    out.flush();
+}
+
+} // namespace mtcache
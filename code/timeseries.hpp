@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gcache/stat.h>
+
+namespace mtcache {
+
+/// Hits and misses at the reference cache size within one epoch
+struct TimeSeriesPoint {
+    uint64_t epoch;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes;
+};
+
+/// Fixed-capacity single-producer single-consumer ring buffer. The replay
+/// thread pushes and the exporter thread drains; neither blocks nor
+/// allocates. A push fails if the exporter has fallen behind.
+class TimeSeriesRing {
+  private:
+    std::unique_ptr<TimeSeriesPoint[]> buf;
+    const uint64_t mask;
+    // head and tail are on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<uint64_t> head; // next slot to write
+    alignas(64) std::atomic<uint64_t> tail; // next slot to read
+
+  public:
+    explicit TimeSeriesRing(size_t capacity);
+
+    bool push(const TimeSeriesPoint& point) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        buf[h & mask] = point;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Fn> size_t drain(Fn&& fn) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        for (uint64_t i = t; i < h; ++i) {
+            fn(buf[i & mask]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+};
+
+/// Per-tenant recorder; accumulates the current epoch on the replay thread
+/// and publishes it into the ring once the epoch is over. The ring only holds
+/// the few epochs that close between drains; points it cannot take wait in a
+/// backlog, which is only allocated if the exporter falls behind.
+class TimeSeriesRecorder {
+  private:
+    uint64_t client;
+    uint64_t epoch_len;
+    TimeSeriesRing ring;
+    // points not yet in the ring, oldest first; only used by the replay
+    // thread, and by the exporter once it is stopped
+    std::vector<TimeSeriesPoint> backlog;
+    size_t backlog_head; // first point of the backlog not yet in the ring
+
+    bool has_epoch;
+    uint64_t epoch;
+    uint64_t bytes;
+    // stat at the reference size when the current epoch began
+    gcache::CacheStat epoch_begin;
+
+    friend class TimeSeriesExporter;
+
+  public:
+    TimeSeriesRecorder(uint64_t client, uint64_t epoch_len, size_t capacity)
+        : client(client), epoch_len(epoch_len), ring(capacity),
+          backlog_head(0), has_epoch(false), epoch(0), bytes(0) {}
+
+    /// Record an access at `timestamp`; `get_stat` returns the cumulative
+    /// stat at the reference size before this access and is only called when
+    /// an epoch ends.
+    template <typename Fn>
+    void record(uint64_t timestamp, uint32_t access_bytes, Fn&& get_stat) {
+        uint64_t ts_epoch = timestamp / epoch_len * epoch_len;
+        if (!has_epoch) {
+            has_epoch = true;
+            epoch = ts_epoch;
+            epoch_begin = get_stat();
+        } else if (ts_epoch != epoch) {
+            close_epoch(get_stat());
+            epoch = ts_epoch;
+        }
+        bytes += access_bytes;
+    }
+
+    /// Publish the current epoch given the stat at its end
+    void close_epoch(const gcache::CacheStat& epoch_end) {
+        if (!has_epoch) {
+            return;
+        }
+        publish({epoch, epoch_end.hit_cnt - epoch_begin.hit_cnt,
+                 epoch_end.miss_cnt - epoch_begin.miss_cnt, bytes});
+        epoch_begin = epoch_end;
+        bytes = 0;
+    }
+
+  private:
+    /// Push a point after the backlog, keeping the order
+    void publish(const TimeSeriesPoint& point) {
+        while (backlog_head < backlog.size() &&
+               ring.push(backlog[backlog_head])) {
+            ++backlog_head;
+        }
+        if (backlog_head == backlog.size()) {
+            backlog.clear();
+            backlog_head = 0;
+            if (ring.push(point)) {
+                return;
+            }
+        }
+        backlog.push_back(point);
+    }
+};
+
+/// Owns every tenant's recorder and periodically drains them from a
+/// background thread into a CSV file: client,epoch,hits,misses,bytes
+///
+/// A ring only needs the epochs one tenant can close within a drain period,
+/// so the default is a handful of points (256 B per tenant); a tenant that
+/// closes more spills into its backlog rather than losing points.
+class TimeSeriesExporter {
+  private:
+    std::ofstream out;
+    uint64_t epoch_len;
+    size_t ring_capacity;
+    std::chrono::milliseconds period;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+    std::vector<std::unique_ptr<TimeSeriesRecorder>> recorders;
+    std::thread worker;
+
+    void export_all(const std::vector<TimeSeriesRecorder*>& snapshot);
+    void run();
+
+  public:
+    TimeSeriesExporter(const std::string& path, uint64_t epoch_len,
+                       size_t ring_capacity = 8,
+                       std::chrono::milliseconds period =
+                           std::chrono::milliseconds(100));
+    ~TimeSeriesExporter();
+
+    /// Create a recorder for a new tenant; the recorder lives as long as the
+    /// exporter
+    TimeSeriesRecorder* make_recorder(uint64_t client);
+
+    /// Stop the background thread after draining every recorder
+    void stop();
+};
+
+} // namespace mtcache
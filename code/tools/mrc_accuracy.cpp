@@ -0,0 +1,157 @@
+// Replay a trace through an approximate MRC engine and the exact
+// SampledGhostKvCache<0> side by side, then report how far the approximate
+// miss ratio curves are from the exact ones.
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <unistd.h>
+
+#include <csv.hpp>
+#include <gcache/aet_kv_cache.h>
+#include <gcache/counter_stack_kv_cache.h>
+#include <gcache/ghost_kv_cache.h>
+
+#include "../trace.hpp"
+
+using mtcache::TraceReq;
+using GhostKvCache = gcache::SampledGhostKvCache<0>;
+
+struct Config {
+    uint32_t tick = 64;
+    uint32_t min_count = 64;
+    uint32_t max_count = 1024;
+};
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-e aet|cs] [-t tick] [-m min] [-M max] <tw|fb> <trace>"
+              << std::endl;
+    exit(1);
+}
+
+template <class Cache>
+int compare(std::ifstream& file, std::function<TraceReq(csv::CSVRow&)>& parser,
+            const Config& config) {
+    std::unordered_map<uint64_t, std::pair<std::unique_ptr<GhostKvCache>,
+                                           std::unique_ptr<Cache>>>
+        tenants;
+    csv::CSVReader reader(file);
+    for (csv::CSVRow& row : reader) {
+        try {
+            auto req = parser(row);
+            auto [it, is_new] = tenants.try_emplace(req.client);
+            if (is_new) {
+                it->second.first = std::make_unique<GhostKvCache>(
+                    config.tick, config.min_count, config.max_count);
+                it->second.second = std::make_unique<Cache>(
+                    config.tick, config.min_count, config.max_count);
+            }
+            it->second.first->access(req.key, req.keySize + req.valSize);
+            it->second.second->access(req.key, req.keySize + req.valSize);
+        } catch (const std::runtime_error& e) {
+            // malformed rows are skipped the same way as in mtcache
+        }
+    }
+
+    // Mean absolute error of the miss ratio over each tenant's curve, then
+    // averaged over tenants weighted by their number of accesses
+    size_t num_compared = 0;
+    size_t num_points = 0;
+    uint64_t weight_sum = 0;
+    double weighted_mae = 0;
+    double max_mae = 0;
+    double max_err = 0;
+    for (auto& [client, caches] : tenants) {
+        auto exact = caches.first->get_cache_stat_curve();
+        auto approx = caches.second->get_cache_stat_curve();
+        size_t n = std::min(exact.size(), approx.size());
+        if (n == 0) continue;
+        double err_sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            auto& e = std::get<2>(exact[i]);
+            auto& a = std::get<2>(approx[i]);
+            double err = std::abs(e.get_miss_rate() - a.get_miss_rate());
+            err_sum += err;
+            max_err = std::max(max_err, err);
+        }
+        double mae = err_sum / n;
+        uint64_t weight = std::get<2>(exact[0]).hit_cnt +
+                          std::get<2>(exact[0]).miss_cnt;
+        weighted_mae += mae * weight;
+        weight_sum += weight;
+        max_mae = std::max(max_mae, mae);
+        num_points += n;
+        ++num_compared;
+    }
+
+    std::cout << "tenants: " << tenants.size()
+              << " (compared: " << num_compared << ", points: " << num_points
+              << ")" << std::endl;
+    if (num_compared == 0) return 0;
+    std::cout << "weighted MAE: " << weighted_mae / weight_sum << std::endl;
+    std::cout << "max tenant MAE: " << max_mae << std::endl;
+    std::cout << "max point error: " << max_err << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    std::string engine("aet");
+    Config config;
+    int opt;
+    while ((opt = getopt(argc, argv, "e:t:m:M:")) != -1) {
+        switch (opt) {
+        case 'e':
+            engine = optarg;
+            break;
+        case 't':
+            config.tick = std::stoul(optarg);
+            break;
+        case 'm':
+            config.min_count = std::stoul(optarg);
+            break;
+        case 'M':
+            config.max_count = std::stoul(optarg);
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(execname);
+    }
+
+    std::string which_trace(argv[optind]);
+    std::function<TraceReq(csv::CSVRow&)> parser;
+    if (which_trace == "tw") {
+        parser = TraceReq::fromTwitterLine;
+    } else if (which_trace == "fb") {
+        parser = TraceReq::fromFacebookLine;
+    } else {
+        usage(execname);
+    }
+
+    std::string trace_path(argv[optind + 1]);
+    std::ifstream file(trace_path);
+    if (!file.is_open()) {
+        std::cerr << trace_path
+                  << ": could not open file: " << std::strerror(errno)
+                  << std::endl;
+        exit(1);
+    }
+
+    if (engine == "aet") {
+        return compare<gcache::AetKvCache<>>(file, parser, config);
+    } else if (engine == "cs") {
+        return compare<gcache::CounterStackKvCache<>>(file, parser, config);
+    }
+    usage(execname);
+}
@@ -0,0 +1,177 @@
+// Derive miss ratio curves from the reuse distance histograms written by
+// `mtcache -X`, without replaying the trace: either each tenant's curve at
+// any set of cache sizes, or the miss ratio of a partitioning of a cache
+// among tenants at each checkpoint.
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gcache/stat.h>
+
+#include "../histogram.hpp"
+
+using mtcache::HistogramReader, mtcache::HistogramRecord;
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-s min:max:step|size,size,...] [-p partition]"
+              << " <histograms>" << std::endl;
+    exit(1);
+}
+
+/// Parse "min:max:step" or a comma-separated list of cache sizes
+std::vector<uint32_t> parse_sizes(const std::string& spec) {
+    std::vector<uint32_t> sizes;
+    if (spec.find(':') != std::string::npos) {
+        std::istringstream iss(spec);
+        uint32_t min, max, step;
+        char sep1, sep2;
+        if (!(iss >> min >> sep1 >> max >> sep2 >> step) || sep1 != ':' ||
+            sep2 != ':' || step == 0 || min > max) {
+            throw std::runtime_error(spec + ": invalid size range");
+        }
+        for (uint64_t c = min; c <= max; c += step) {
+            sizes.push_back(c);
+        }
+    } else {
+        std::istringstream iss(spec);
+        std::string size;
+        while (std::getline(iss, size, ',')) {
+            sizes.push_back(std::stoul(size));
+        }
+    }
+    return sizes;
+}
+
+/// Read a partitioning: one "client size" per line; '#' starts a comment
+std::map<uint64_t, uint32_t> parse_partition(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    std::map<uint64_t, uint32_t> partition;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream iss(line);
+        uint64_t client;
+        uint32_t size;
+        if (!(iss >> client)) {
+            continue; // blank line
+        }
+        if (!(iss >> size)) {
+            throw std::runtime_error(path + ": invalid line: " + line);
+        }
+        partition[client] = size;
+    }
+    return partition;
+}
+
+/// Print each tenant's miss ratio at each size at each checkpoint where it
+/// has a record, i.e., where it has had accesses since its previous one
+void derive_curves(HistogramReader& reader,
+                   const std::vector<uint32_t>& sizes) {
+    std::cout << "client,ts,count,miss_ratio" << std::endl;
+    HistogramRecord rec;
+    while (reader.next(rec)) {
+        if (rec.hist.total == 0) {
+            continue;
+        }
+        for (uint32_t count : sizes) {
+            std::cout << rec.client << "," << rec.timestamp << "," << count
+                      << "," << rec.hist.get_stat(count).get_miss_rate()
+                      << std::endl;
+        }
+    }
+}
+
+/// Print each tenant's miss ratio at its share of the partitioning, and the
+/// overall miss ratio, at each checkpoint; tenants without a share get no
+/// cache, so all their accesses miss
+void derive_partition(HistogramReader& reader,
+                      const std::map<uint64_t, uint32_t>& partition) {
+    std::cout << "ts,client,count,miss_ratio" << std::endl;
+    uint64_t total_count = 0;
+    for (auto& [client, count] : partition) {
+        total_count += count;
+    }
+    // stat of each tenant at its share as of its latest record, which also
+    // holds at later checkpoints without a record of it
+    std::map<uint64_t, gcache::CacheStat> latest;
+    uint64_t ts = 0;
+    auto flush = [&] {
+        gcache::CacheStat overall;
+        for (auto& [client, stat] : latest) {
+            overall.hit_cnt += stat.hit_cnt;
+            overall.miss_cnt += stat.miss_cnt;
+        }
+        if (overall.hit_cnt + overall.miss_cnt) {
+            std::cout << ts << ",all," << total_count << ","
+                      << overall.get_miss_rate() << std::endl;
+        }
+    };
+
+    HistogramRecord rec;
+    bool any = false;
+    while (reader.next(rec)) {
+        // records of one checkpoint are contiguous
+        if (any && rec.timestamp != ts) {
+            flush();
+        }
+        any = true;
+        ts = rec.timestamp;
+        auto it = partition.find(rec.client);
+        uint32_t count = it == partition.end() ? 0 : it->second;
+        auto stat = rec.hist.get_stat(count);
+        latest[rec.client] = stat;
+        if (it != partition.end() && rec.hist.total) {
+            std::cout << ts << "," << rec.client << "," << count << ","
+                      << stat.get_miss_rate() << std::endl;
+        }
+    }
+    if (any) {
+        flush();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    std::string size_spec("64:1024:64");
+    std::string partition_path;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:")) != -1) {
+        switch (opt) {
+        case 's':
+            size_spec = optarg;
+            break;
+        case 'p':
+            partition_path = optarg;
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (argc - optind != 1) {
+        usage(execname);
+    }
+
+    try {
+        HistogramReader reader(argv[optind]);
+        if (partition_path.empty()) {
+            derive_curves(reader, parse_sizes(size_spec));
+        } else {
+            derive_partition(reader, parse_partition(partition_path));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
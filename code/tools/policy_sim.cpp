@@ -0,0 +1,346 @@
+// Replay a trace against real-capacity simulators of eviction policies (LRU,
+// FIFO, CLOCK, SIEVE, S3-FIFO, 2Q, ARC, LFU) at a grid of cache sizes for
+// each tenant, and write each policy's curves in the same format as mtcache
+// does, to <outdir>/<policy>/<client>, so policies can be compared at equal
+// cost. With -S, the simulators are miniature ones on 1 in up to 32 keys, as
+// many as the grid allows (see MiniSimKvCache).
+//
+// The trace is parsed once, a chunk at a time, while the previous chunk is
+// replayed on worker threads; the grid of each policy is split into strided
+// shards, which are independent of each other.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <csv.hpp>
+#include <gcache/mini_sim_kv_cache.h>
+#include <gcache/policy_kv_cache.h>
+#include <nlohmann/json.hpp>
+
+#include "../cache.hpp"
+#include "../tenant_map.hpp"
+#include "../trace.hpp"
+
+namespace fs = std::filesystem;
+using mtcache::MissRateCurve;
+using mtcache::TraceReq;
+
+// same as TIME_DELTA in main.cpp
+constexpr uint64_t kCheckpointInterval = 10;
+constexpr size_t kChunkRows = 1 << 16;
+// most sampling of the miniature simulations
+constexpr uint32_t kMaxSampleShift = 5;
+
+struct Config {
+    uint32_t tick = 64;
+    uint32_t min_count = 64;
+    uint32_t max_count = 1024;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    bool sampled = false;
+    uint32_t sample_shift = 0; // of the miniature simulations
+    std::vector<std::string> policies{"lru",  "fifo", "clock", "sieve",
+                                      "s3fifo", "2q", "arc",   "lfu"};
+    std::string outdir = "policy_mrc";
+};
+
+void usage(std::string& execname) {
+    std::cout << "usage: " << execname
+              << " [-p lru,fifo,clock,sieve,s3fifo,2q,arc,lfu] [-t tick]"
+                 " [-m min] [-M max] [-j threads] [-o outdir] [-S]"
+                 " <tw|fb> <trace>"
+              << std::endl;
+    exit(1);
+}
+
+/// The curves of one tenant under one policy, merged from all shards
+struct PolicyTenant {
+    std::optional<uint64_t> first_ts;
+    std::optional<uint64_t> last_ts;
+    std::map<uint64_t, MissRateCurve> curves;
+};
+
+/// The simulators of one policy for every tenant, at the sizes min_count,
+/// min_count + tick, ... up to max_count
+class PolicyShard {
+  public:
+    virtual ~PolicyShard() = default;
+    virtual void replay(const std::vector<TraceReq>& reqs) = 0;
+    /// Add this shard's points to the curves of each tenant
+    virtual void collect(std::map<uint64_t, PolicyTenant>& tenants) const = 0;
+};
+
+template <class Cache> class Shard : public PolicyShard {
+  private:
+    uint32_t tick;
+    uint32_t min_count;
+    uint32_t max_count;
+    mtcache::TenantMap<mtcache::TenantCache<Cache>> tenants;
+    uint64_t saveTs = 0;
+
+  public:
+    Shard(uint32_t tick, uint32_t min_count, uint32_t max_count)
+        : tick(tick), min_count(min_count), max_count(max_count) {}
+
+    void replay(const std::vector<TraceReq>& reqs) override {
+        for (auto& req : reqs) {
+            // checkpoint at the same timestamps as mtcache does
+            if (req.timeStamp - saveTs > kCheckpointInterval) {
+                saveTs = (req.timeStamp / kCheckpointInterval) *
+                         kCheckpointInterval;
+                for (auto& kv : tenants) {
+                    kv.second.checkpoint_stats(saveTs);
+                }
+            }
+            tenants.try_emplace(req.client, tick, min_count, max_count)
+                .first->second.access(req);
+        }
+    }
+
+    void collect(std::map<uint64_t, PolicyTenant>& out) const override {
+        for (auto& [client, tenant] : tenants) {
+            auto& merged = out[client];
+            merged.first_ts = tenant.get_first_ts();
+            merged.last_ts = tenant.get_last_ts();
+            for (auto& [ts, curve] : tenant.get_checkpoint_curves()) {
+                auto& points = merged.curves[ts];
+                points.insert(points.end(), curve.begin(), curve.end());
+            }
+        }
+    }
+};
+
+/// A shard of miniature simulators at a sample shift known at run time
+template <class Policy, uint32_t Shift = kMaxSampleShift>
+std::unique_ptr<PolicyShard> make_mini_shard(uint32_t shift, uint32_t tick,
+                                             uint32_t min_count,
+                                             uint32_t max_count) {
+    if constexpr (Shift > 0) {
+        if (shift < Shift) {
+            return make_mini_shard<Policy, Shift - 1>(shift, tick, min_count,
+                                                      max_count);
+        }
+    }
+    using Cache = gcache::MiniSimKvCache<Policy, Shift>;
+    return std::make_unique<Shard<Cache>>(tick, min_count, max_count);
+}
+
+/// Shard `i` of `n` of a policy's grid, or nullptr if there is no such policy
+std::unique_ptr<PolicyShard> make_shard(const std::string& policy,
+                                        const Config& config, uint32_t i,
+                                        uint32_t n) {
+    uint32_t tick = config.tick * n;
+    uint32_t min_count = config.min_count + config.tick * i;
+    uint32_t max_count = config.max_count;
+    auto make = [&]<class Policy>() -> std::unique_ptr<PolicyShard> {
+        if (config.sampled) {
+            return make_mini_shard<Policy>(config.sample_shift, tick,
+                                           min_count, max_count);
+        }
+        using Cache = gcache::PolicyKvCache<Policy>;
+        return std::make_unique<Shard<Cache>>(tick, min_count, max_count);
+    };
+    if (policy == "lru") {
+        return make.template operator()<gcache::LruCache>();
+    } else if (policy == "fifo") {
+        return make.template operator()<gcache::FifoCache>();
+    } else if (policy == "clock") {
+        return make.template operator()<gcache::ClockCache>();
+    } else if (policy == "sieve") {
+        return make.template operator()<gcache::SieveCache>();
+    } else if (policy == "s3fifo") {
+        return make.template operator()<gcache::S3FifoCache>();
+    } else if (policy == "2q") {
+        return make.template operator()<gcache::TwoQCache>();
+    } else if (policy == "arc") {
+        return make.template operator()<gcache::ArcCache>();
+    } else if (policy == "lfu") {
+        return make.template operator()<gcache::LfuCache>();
+    }
+    return nullptr;
+}
+
+int simulate(std::ifstream& file,
+             std::function<TraceReq(csv::CSVRow&)>& parser,
+             const Config& config) {
+    auto start = std::chrono::steady_clock::now();
+
+    // split each policy's grid into as many shards as there are threads per
+    // policy, but no more than its number of sizes
+    uint32_t num_sizes =
+        (config.max_count - config.min_count) / config.tick + 1;
+    uint32_t num_shards = std::clamp<size_t>(
+        config.threads / config.policies.size(), 1, num_sizes);
+    std::vector<std::unique_ptr<PolicyShard>> shards;
+    for (auto& policy : config.policies) {
+        for (uint32_t i = 0; i < num_shards; ++i) {
+            auto shard = make_shard(policy, config, i, num_shards);
+            if (!shard) {
+                std::cerr << "unknown policy: " << policy << std::endl;
+                return 1;
+            }
+            shards.push_back(std::move(shard));
+        }
+    }
+    size_t num_threads = std::min(config.threads, shards.size());
+
+    csv::CSVReader reader(file);
+    auto row = reader.begin();
+    uint64_t row_number = 1;
+    uint64_t num_reqs = 0;
+    auto parse_chunk = [&](std::vector<TraceReq>& reqs) {
+        reqs.clear();
+        while (reqs.size() < kChunkRows && row != reader.end()) {
+            try {
+                reqs.push_back(parser(*row));
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Skipped line " << row_number << " in trace ("
+                          << e.what() << ")" << std::endl;
+            }
+            ++row;
+            ++row_number;
+        }
+        num_reqs += reqs.size();
+    };
+
+    std::vector<TraceReq> chunk;
+    std::vector<TraceReq> next;
+    parse_chunk(chunk);
+    while (!chunk.empty()) {
+        std::vector<std::thread> workers;
+        for (size_t w = 0; w < num_threads; ++w) {
+            workers.emplace_back([&, w] {
+                for (size_t j = w; j < shards.size(); j += num_threads) {
+                    shards[j]->replay(chunk);
+                }
+            });
+        }
+        parse_chunk(next);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        std::swap(chunk, next);
+    }
+
+    fs::create_directory(config.outdir);
+    for (size_t p = 0; p < config.policies.size(); ++p) {
+        std::map<uint64_t, PolicyTenant> tenants;
+        for (uint32_t i = 0; i < num_shards; ++i) {
+            shards[p * num_shards + i]->collect(tenants);
+        }
+        auto outdir = fs::path(config.outdir) / config.policies[p];
+        fs::create_directory(outdir);
+        for (auto& [client, tenant] : tenants) {
+            using json = nlohmann::json;
+            json out_obj;
+            out_obj["first_ts"] = *tenant.first_ts;
+            out_obj["last_ts"] = *tenant.last_ts;
+            out_obj["mrcs"] = json::object();
+            for (auto& [ts, curve] : tenant.curves) {
+                std::sort(curve.begin(), curve.end(), [](auto& a, auto& b) {
+                    return std::get<0>(a) < std::get<0>(b);
+                });
+                out_obj["mrcs"][std::to_string(ts)] =
+                    mtcache::miss_rate_curve_as_strings(curve);
+            }
+            std::ofstream outstream(outdir / std::to_string(client));
+            outstream << out_obj.dump() << std::endl;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::cout << "replayed " << num_reqs << " requests against "
+              << config.policies.size() << " policies at " << num_sizes
+              << " sizes (" << num_shards << " shards each) on "
+              << num_threads << " threads in " << elapsed << " s"
+              << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string execname(argv[0]);
+    Config config;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:m:M:j:o:S")) != -1) {
+        switch (opt) {
+        case 'p': {
+            config.policies.clear();
+            std::istringstream names(optarg);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                config.policies.push_back(name);
+            }
+            break;
+        }
+        case 't':
+            config.tick = std::stoul(optarg);
+            break;
+        case 'm':
+            config.min_count = std::stoul(optarg);
+            break;
+        case 'M':
+            config.max_count = std::stoul(optarg);
+            break;
+        case 'j':
+            config.threads = std::max(1ul, std::stoul(optarg));
+            break;
+        case 'o':
+            config.outdir = optarg;
+            break;
+        case 'S':
+            config.sampled = true;
+            break;
+        default:
+            usage(execname);
+        }
+    }
+    if (argc - optind != 2 || config.policies.empty() || config.tick == 0 ||
+        config.min_count == 0 || config.min_count > config.max_count) {
+        usage(execname);
+    }
+    // the miniature caches are the sizes scaled down by the sampling rate, as
+    // far as the smallest stays large enough
+    if (config.sampled) {
+        config.sample_shift = gcache::mini_sim_sample_shift(
+            config.tick, config.min_count, config.max_count, kMaxSampleShift);
+        std::cerr << "-S: simulating 1 in " << (1u << config.sample_shift)
+                  << " keys" << std::endl;
+    }
+
+    std::string which_trace(argv[optind]);
+    std::function<TraceReq(csv::CSVRow&)> parser;
+    if (which_trace == "tw") {
+        parser = TraceReq::fromTwitterLine;
+    } else if (which_trace == "fb") {
+        parser = TraceReq::fromFacebookLine;
+    } else {
+        usage(execname);
+    }
+
+    std::string trace_path(argv[optind + 1]);
+    std::ifstream file(trace_path);
+    if (!file.is_open()) {
+        std::cerr << trace_path
+                  << ": could not open file: " << std::strerror(errno)
+                  << std::endl;
+        exit(1);
+    }
+
+    return simulate(file, parser, config);
+}
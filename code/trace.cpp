@@ -1,6 +1,9 @@
+#include <cassert>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 #include "csv.hpp"
 #include "trace.hpp"
@@ -37,4 +40,54 @@ TraceReq TraceReq::fromFacebookLine(csv::CSVRow& row) {
         get<uint32_t>(row[2], "keySize"), get<uint32_t>(row[5], "valSize"),
         get<uint64_t>(row[8], "client"), get<std::string>(row[3], "operation"));
 }
+
+TraceStream::TraceStream(const std::string& path, uint64_t offset)
+    : std::istream(nullptr) {
+    rdbuf(&buf);
+    if (!buf.open(path, std::ios::in) ||
+        buf.pubseekoff(offset, std::ios::beg) == std::streampos(-1)) {
+        setstate(std::ios::failbit);
+        return;
+    }
+    buf.base = offset;
+}
+
+TraceStream::TraceStream(TraceStream&& other)
+    : std::istream(std::move(other)), buf(std::move(other.buf)) {
+    set_rdbuf(&buf);
+}
+
+TraceStream::OffsetBuf::pos_type
+TraceStream::OffsetBuf::seekoff(off_type off, std::ios::seekdir dir,
+                                std::ios::openmode which) {
+    if (dir == std::ios::beg) {
+        off += base;
+    }
+    pos_type pos = std::filebuf::seekoff(off, dir, which);
+    return pos == pos_type(-1) ? pos : pos - base;
+}
+
+TraceStream::OffsetBuf::pos_type
+TraceStream::OffsetBuf::seekpos(pos_type pos, std::ios::openmode which) {
+    pos = std::filebuf::seekpos(pos + base, which);
+    return pos == pos_type(-1) ? pos : pos - base;
+}
+
+TraceOffsetTracker::TraceOffsetTracker(const std::string& path,
+                                       uint64_t offset)
+    : file(path, std::ios::binary), offset(offset), line(0) {
+    if (!file.is_open()) {
+        throw std::runtime_error(path + ": could not open file");
+    }
+    file.seekg(offset);
+}
+
+uint64_t TraceOffsetTracker::offset_of_line(uint64_t n) {
+    assert(n >= line);
+    for (; line < n && file; ++line) {
+        file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        offset += file.gcount();
+    }
+    return offset;
+}
 } // namespace mtcache
\ No newline at end of file
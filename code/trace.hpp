@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <fstream>
+#include <istream>
 #include <string>
 
 #include "csv.hpp"
@@ -19,4 +22,48 @@ struct TraceReq {
     static TraceReq fromTwitterLine(csv::CSVRow&);
     static TraceReq fromFacebookLine(csv::CSVRow&);
 };
+
+/// Reads a trace file from a byte offset on as if the file began there, so
+/// positions are relative to the offset. The CSV reader parses a stream from
+/// position 0 to its end whatever its position, so this is how a replay
+/// starts in the middle of a trace.
+class TraceStream : public std::istream {
+  private:
+    class OffsetBuf : public std::filebuf {
+      public:
+        std::streamoff base = 0;
+
+      protected:
+        pos_type seekoff(off_type off, std::ios::seekdir dir,
+                         std::ios::openmode which) override;
+        pos_type seekpos(pos_type pos, std::ios::openmode which) override;
+    };
+    OffsetBuf buf;
+
+  public:
+    TraceStream(const std::string& path, uint64_t offset = 0);
+    /// The CSV reader moves the stream it is given into itself
+    TraceStream(TraceStream&& other);
+
+    bool is_open() const { return buf.is_open(); }
+};
+
+/// Finds the byte offset of a line in a trace so that a replay can later
+/// resume from there; assumes each CSV row is exactly one line. It only scans
+/// forward from the last line asked for, so over a whole replay it reads the
+/// trace once more at most.
+class TraceOffsetTracker {
+  private:
+    std::ifstream file;
+    uint64_t offset;
+    uint64_t line;
+
+  public:
+    /// Lines are counted from byte `offset`
+    TraceOffsetTracker(const std::string& path, uint64_t offset = 0);
+
+    /// Byte offset of the beginning of the `n`-th line (0-based), which must
+    /// not be before the last one asked for
+    uint64_t offset_of_line(uint64_t n);
+};
 } // namespace mtcache
\ No newline at end of file